@@ -0,0 +1,70 @@
+#ifndef FRAME_SINK_H
+#define FRAME_SINK_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+#include "aligned.h"
+
+// raw RGBA bytes back to back, or a YUV4MPEG2 (4:2:0) stream that video
+// encoders like ffmpeg can read directly
+enum class FrameFormat { rgba, y4m };
+
+/* Asynchronous Frame Sink
+ *
+ * Streams rendered frames to a file, a named pipe or stdout ("-") from a
+ * writer thread. Frames are handed over through a single producer single
+ * consumer ring of preallocated buffers: submitting swaps the caller's
+ * buffer with a free slot, so nothing is copied on the render thread and
+ * it only ever waits when the writer has fallen a whole ring behind.
+ */
+class FrameSink {
+   public:
+    FrameSink(const std::string& path,
+              int width,
+              int height,
+              FrameFormat format,
+              int fps = 30,
+              int nslots = 4);
+
+    // writes out all the frames that are still queued
+    ~FrameSink();
+
+    FrameSink(const FrameSink&) = delete;
+    void operator=(const FrameSink&) = delete;
+
+    // queue the ARGB8888 frame. It is swapped with a buffer of the same size
+    // whose contents are left over from an earlier frame.
+    void submit(PixelBuffer& frame);
+
+    // did writing to the output fail (e.g. the reader closed the pipe)? From
+    // then on the frames are dropped.
+    bool failed() const;
+
+   private:
+    void write_frames();
+    void write_rgba(const PixelBuffer& frame);
+    void write_y4m(const PixelBuffer& frame);
+
+    // set in head_ once the sink is closing
+    static constexpr uint64_t CLOSED = uint64_t{1} << 63;
+
+    int width_;
+    int height_;
+    FrameFormat format_;
+    std::FILE* out_{};
+    std::vector<PixelBuffer> slots_;
+    std::vector<uint8_t> staging_{};  // converted frame, writer thread only
+
+    // frames submitted / frames written. Slot i % slots_.size() belongs to
+    // the writer while tail_ <= i < head_ and to the producer otherwise.
+    std::atomic<uint64_t> head_{0};
+    std::atomic<uint64_t> tail_{0};
+    std::atomic<bool> failed_{false};
+    std::thread writer_;
+};
+
+#endif
@@ -0,0 +1,46 @@
+#ifndef MEMORY_STATS_H
+#define MEMORY_STATS_H
+
+#include <cstddef>
+#include <cstdint>
+
+// heap allocations made through operator new
+struct AllocationStats {
+    uint64_t count{};
+    uint64_t bytes{};
+};
+
+/* Allocation Tracing
+ *
+ * operator new and delete are replaced by versions that count every
+ * allocation of the process before handing it to malloc. The counters are
+ * process wide, so allocations made by other threads (model loading, frame
+ * writing) show up in every measurement that overlaps with them.
+ *
+ * memory_stats.cpp is not part of renderer_core, only executables that list
+ * it among their own sources (replay) get the replaced operators.
+ */
+namespace MemoryStats {
+// allocations made since the program started
+AllocationStats allocations();
+
+// called with the size of every allocation, e.g. to trace where the
+// allocations of a frame come from or to abort on them. It must not
+// allocate itself. nullptr removes the hook.
+using AllocationHook = void (*)(std::size_t bytes);
+void set_allocation_hook(AllocationHook hook);
+}  // namespace MemoryStats
+
+// counts the allocations made while it is alive
+class AllocationScope {
+   public:
+    AllocationScope();
+
+    // allocations since the scope was created
+    AllocationStats stats() const;
+
+   private:
+    AllocationStats start_;
+};
+
+#endif
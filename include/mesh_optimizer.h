@@ -0,0 +1,36 @@
+#ifndef MESH_OPTIMIZER_H
+#define MESH_OPTIMIZER_H
+
+#include <vector>
+#include "vector.h"
+
+// Load-time mesh optimization passes. All of these operate on a flat
+// triangle list where every 3 consecutive entries of `indices` make up a
+// triangle.
+namespace MeshOptimization {
+// size of the post-transform vertex cache the triangle order is tuned for
+constexpr int VERTEX_CACHE_SIZE = 16;
+
+// number of consecutive triangles that are kept together when sorting the
+// mesh spatially
+constexpr int CLUSTER_SIZE = 64;
+
+// reorder the triangles for post-transform vertex cache reuse using the
+// Tipsify algorithm from: Fast Triangle Reordering for Vertex Locality and
+// Reduced Overdraw by P. Sander, D. Nehab and J. Barczak
+std::vector<int> tipsify(const std::vector<int>& indices,
+                         int nverts,
+                         int cache_size);
+
+// sort runs of CLUSTER_SIZE triangles along a Morton (Z-order) curve through
+// the bounding box of the mesh so that consecutive clusters are close to
+// each other in space (and therefore also on the screen).
+std::vector<int> spatial_order(const std::vector<int>& indices,
+                               const std::vector<Vector<4>>& positions);
+
+// renumber the vertices in the order they are first referenced by the index
+// buffer. Returns the old index of every new vertex.
+std::vector<int> fetch_order(std::vector<int>& indices, int nverts);
+}  // namespace MeshOptimization
+
+#endif
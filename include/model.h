@@ -1,7 +1,14 @@
 #ifndef MODEL_H
 #define MODEL_H
 
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <numbers>
 #include <string>
+#include <string_view>
+#include <utility>
 #include <vector>
 #include "vector.h"
 
@@ -30,39 +37,136 @@ typedef struct TextureCoord_t {
     }
 } TextureCoord;
 
-// index values of 0 for text and or normal will represent null values
-// need to handle case for entries in first and third location but not second
+// index values of -1 for text and or normal will represent null values
 typedef struct FaceTuple_t {
     int vertex;
     int texture;
     int normal;
 
-    FaceTuple_t(int vertex) : vertex{vertex}, texture{0}, normal{0} {}
+    FaceTuple_t(int vertex) : vertex{vertex}, texture{-1}, normal{-1} {}
     FaceTuple_t(int vertex, int texture)
-        : vertex{vertex}, texture{texture}, normal{0} {}
+        : vertex{vertex}, texture{texture}, normal{-1} {}
     FaceTuple_t(int vertex, int texture, int normal)
         : vertex{vertex}, texture{texture}, normal{normal} {}
 } FaceTuple;
 
+// options for the extra work done while loading a model
+struct ModelOptions {
+    // run the mesh through Model::optimize() and store the result next to
+    // the .obj file so later loads can skip the work.
+    bool optimize{false};
+
+    // corners the file gives no normal get generated ones, the normals in
+    // the file are kept. Neighbouring faces meeting at a larger angle (in
+    // radians) than this keep separate normals so hard edges stay hard.
+    float crease_angle{std::numbers::pi_v<float>};
+
+    // store positions quantized to 16 bits per axis inside the bounding box
+    // and normals octahedral encoded with normal_bits (8 or 16) bits per
+    // component. Cuts the vertex data to about a quarter of its size.
+    bool compact{false};
+    int normal_bits{16};
+};
+
+// a run of consecutive faces and their bounding box, used for culling
+struct Cluster {
+    int first_face;
+    int nfaces;
+    Vector<3> lo;
+    Vector<3> hi;
+};
+
+// bytes of heap memory held by each part of a model
+struct ModelMemory {
+    std::size_t positions{};
+    std::size_t normals{};
+    std::size_t faces{};     // the index tuples of the faces
+    std::size_t clusters{};  // culling bounds
+
+    std::size_t total() const;
+};
+
 class Model {
    private:
     std::vector<Vector<4>> verticies;
     std::vector<std::vector<FaceTuple>> faces;
     std::vector<Vector<4>> normals;
 
+    // compact storage, see ModelOptions::compact. A position decodes to
+    // position_origin + position_scale * packed
+    bool compact_{false};
+    int normal_bits_{16};
+    std::vector<std::array<uint16_t, 3>> packed_verticies{};
+    std::vector<uint16_t> packed_normals8{};
+    std::vector<uint32_t> packed_normals16{};
+    Vector<3> position_origin{};
+    Vector<3> position_scale{};
+
+    std::vector<Cluster> clusters_{};
+    uint64_t revision_{};
+
+    void load_obj(const std::string& filename,
+                  const ModelOptions& options,
+                  const std::function<void(float)>& progress);
+    void compress(int normal_bits);
+    void build_clusters();
+    bool load_cache(const std::string& filename,
+                    const std::string& cache,
+                    const ModelOptions& options);
+    void save_cache(const std::string& cache,
+                    const ModelOptions& options) const;
+
    public:
-    Model(std::string filename);
+    // progress is called every so often with the fraction of the file that
+    // has been read so far.
+    Model(std::string filename,
+          const ModelOptions& options = {},
+          const std::function<void(float)>& progress = {});
     int nfaces() const;
     Vector<4> vertex(int i) const;
     Vector<4> normal(int i) const;
-    std::vector<FaceTuple> face(int i) const;
+    const std::vector<FaceTuple>& face(int i) const;
+
+    // the memory the model holds on to (including unused capacity)
+    ModelMemory memory_usage() const;
+
+    // is the vertex data stored quantized (decoded by vertex() and normal())
+    bool compact() const;
+
+    // the faces split into runs of MeshOptimization::CLUSTER_SIZE. After
+    // optimize() every cluster is a spatially coherent group of triangles.
+    const std::vector<Cluster>& clusters() const;
+
+    // changes whenever the geometry or normals change and is never the same
+    // for two models, so results derived from a model can be cached by it
+    uint64_t revision() const;
+
+    // merge the position/normal pairs of the faces into a single index space,
+    // triangulate the faces and reorder them for vertex cache reuse and
+    // spatial locality. Afterwards vertex(i) and normal(i) belong together.
+    void optimize();
+
+    // give corners without a normal the area and angle weighted average of
+    // the normals of the faces around their vertex. Faces whose normals
+    // differ by more than crease_angle are not averaged together.
+    void generate_normals(float crease_angle);
 };
 
+namespace Compression {
+// octahedral normal encoding from: A Survey of Efficient Representations for
+// Independent Unit Vectors by Z. Cigolle et al. Returns the two components
+// quantized to the given number of bits.
+std::pair<uint32_t, uint32_t> encode_octahedral(const Vector<3>& n, int bits);
+Vector<4> decode_octahedral(uint32_t u, uint32_t v, int bits);
+}  // namespace Compression
+
 namespace ModelParsing {
-Vector<4> parse_vector(const std::string& line);
-std::vector<FaceTuple> parse_face(const std::string& line);
-FaceTuple parse_face_tuple(const std::string& line);
-std::vector<std::string> split_string(const std::string& str);
+Vector<4> parse_vector(std::string_view line);
+std::vector<FaceTuple> parse_face(std::string_view line);
+FaceTuple parse_face_tuple(std::string_view line);
+
+// the words point into str, only the returned vector is allocated
+std::vector<std::string_view> split_string(std::string_view str);
 }  // namespace ModelParsing
 
 #endif
@@ -0,0 +1,63 @@
+#ifndef MODEL_CACHE_H
+#define MODEL_CACHE_H
+
+#include <cstddef>
+#include <filesystem>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include "model.h"
+#include "model_loader.h"
+
+/* Model Cache
+ *
+ * Keeps parsed models in memory for a long running process. Models are
+ * keyed by their path and the modification time of the file, so a model is
+ * loaded again once its file changes. When the models take up more than the
+ * memory budget the least recently used ones are dropped (models that are
+ * still in use stay alive until they are no longer drawn).
+ *
+ * Any number of threads can ask for models at once. A model is only ever
+ * loaded once, everyone asking for it while it loads waits for that load.
+ */
+class ModelCache {
+   public:
+    explicit ModelCache(std::size_t max_bytes,
+                        ModelOptions options = {},
+                        int nthreads = 1);
+
+    ModelCache(const ModelCache&) = delete;
+    void operator=(const ModelCache&) = delete;
+
+    // the model of the file, loading it if it isn't cached. Throws what the
+    // Model constructor throws and std::runtime_error for missing files.
+    std::shared_ptr<const Model> get(const std::string& filename);
+
+    // number of cached models and the memory they use
+    int size() const;
+    std::size_t bytes() const;
+
+   private:
+    struct Entry {
+        std::string filename;
+        std::filesystem::file_time_type mtime;
+        ModelLoad load;
+        std::size_t bytes;  // 0 until the load finished
+    };
+
+    void evict();
+
+    std::size_t max_bytes_;
+    ModelOptions options_;
+    ModelLoader loader_;
+
+    // most recently used first
+    mutable std::mutex mutex_{};
+    std::list<Entry> entries_{};
+    std::unordered_map<std::string, std::list<Entry>::iterator> index_{};
+    std::size_t bytes_{0};
+};
+
+#endif
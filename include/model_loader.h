@@ -0,0 +1,86 @@
+#ifndef MODEL_LOADER_H
+#define MODEL_LOADER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <queue>
+#include <string>
+#include <thread>
+#include <vector>
+#include "model.h"
+
+// Handle to a model that is being loaded in the background.
+class ModelLoad {
+   public:
+    // fraction of the model that has been loaded in the range [0, 1]
+    float progress() const;
+
+    // has the model finished loading (or failed to load)?
+    bool ready() const;
+
+    // wait for the model to finish loading. Rethrows anything the Model
+    // constructor threw.
+    std::shared_ptr<const Model> get() const;
+
+   private:
+    friend class ModelLoader;
+    std::shared_ptr<std::atomic<float>> progress_{};
+    std::shared_future<std::shared_ptr<const Model>> model_{};
+};
+
+/* Background Model Loader
+ *
+ * Parses models on a small pool of worker threads so that the caller can
+ * keep rendering while a new model is being loaded.
+ */
+class ModelLoader {
+   public:
+    explicit ModelLoader(int nthreads = 1);
+    ~ModelLoader();
+
+    ModelLoader(const ModelLoader&) = delete;
+    void operator=(const ModelLoader&) = delete;
+
+    // queue the model to be loaded and return a handle for it
+    ModelLoad load(std::string filename, ModelOptions options = {});
+
+   private:
+    void work();
+
+    std::vector<std::thread> workers_{};
+    std::queue<std::function<void()>> jobs_{};
+    std::mutex mutex_{};
+    std::condition_variable cv_{};
+    bool stopping_{false};
+};
+
+// Holds the model that is currently being drawn. A newly loaded model is
+// swapped in atomically once it is ready, until then the old one stays in
+// place.
+class ModelSlot {
+   public:
+    // the model to draw this frame (may be empty before the first swap)
+    std::shared_ptr<const Model> current() const;
+
+    // replace the model once the given load is done
+    void request(ModelLoad load);
+
+    // swap the pending model in if it has finished loading. Returns true if
+    // the current model changed. A failed load is logged and the current
+    // model is kept.
+    bool poll();
+
+    // the load that has not been swapped in yet, if any
+    const std::optional<ModelLoad>& pending() const;
+
+   private:
+    std::atomic<std::shared_ptr<const Model>> current_{};
+    std::optional<ModelLoad> pending_{};
+};
+
+#endif
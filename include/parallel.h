@@ -0,0 +1,34 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+// smallest number of iterations worth handing to a thread of its own
+constexpr int MIN_PARALLEL_WORK = 4096;
+
+// call f(i) for every i in [0, n) with the range split evenly across the
+// hardware threads. f may only write to data owned by index i, there is no
+// other synchronization.
+template <typename F>
+void parallel_for(int n, const F& f) {
+    int nthreads{static_cast<int>(std::thread::hardware_concurrency())};
+    nthreads = std::clamp((n + MIN_PARALLEL_WORK - 1) / MIN_PARALLEL_WORK, 1,
+                          std::max(nthreads, 1));
+
+    int chunk{(n + nthreads - 1) / nthreads};
+    auto run = [&f, chunk, n](int t) {
+        for (int i = t * chunk; i < std::min(n, (t + 1) * chunk); i++)
+            f(i);
+    };
+
+    std::vector<std::thread> threads{};
+    for (int t = 1; t < nthreads; t++)
+        threads.emplace_back(run, t);
+    run(0);
+    for (std::thread& thread : threads)
+        thread.join();
+}
+
+#endif
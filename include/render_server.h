@@ -0,0 +1,99 @@
+#ifndef RENDER_SERVER_H
+#define RENDER_SERVER_H
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <thread>
+#include <vector>
+#include "model_cache.h"
+#include "renderer.h"
+#include "shader.h"
+#include "vector.h"
+
+// A request to render one frame to an image file, read from a single line:
+//
+//     render id 7 model obj_files/head.obj output head.ppm resolution 640 480
+//            shading phong yaw 30 pitch 10 light 0 0 -1 camera 0 0 255
+//
+// Only model and output are required, the rest defaults to what the
+// renderer uses. Angles are given in degrees and the frame is written as a
+// binary PPM. With shading shadows the light also casts the shadows, and
+// like the shadow light of the renderer it is then given in model space.
+//
+// The reply is a line with the id (if any) and either the time spent
+// drawing and the time the whole request took in milliseconds, or what went
+// wrong (requests are drawn concurrently so replies can come back in a
+// different order):
+//
+//     ok 7 1.92 2.05
+//     error 7 could not open model obj_files/head.obj
+struct RenderRequest {
+    std::string id{"-"};
+    std::string model{};
+    std::string output{};
+    int width{SCREEN_WIDTH};
+    int height{SCREEN_HEIGHT};
+    ShadingMode shading{ShadingMode::flat};
+    float yaw{0.f};
+    float pitch{0.f};
+    Vector<3> light_dir{0.f, 0.f, -1.f};
+    Vector<3> camera{0.f, 0.f, 255.f};
+};
+
+/* Render Server
+ *
+ * Draws requested frames on a pool of worker threads, each with its own
+ * headless renderer. The models come from a shared ModelCache, so once a
+ * model is warm a request only costs the time it takes to draw it.
+ */
+class RenderServer {
+   public:
+    using Reply = std::function<void(const std::string&)>;
+
+    RenderServer(ModelCache& cache, int nworkers);
+
+    // finishes every request that was already submitted
+    ~RenderServer();
+
+    RenderServer(const RenderServer&) = delete;
+    void operator=(const RenderServer&) = delete;
+
+    // parse the request line and queue it. reply is called with the reply
+    // line (without the newline) from one of the workers, or right away if
+    // the request can't be parsed.
+    void submit(const std::string& line, Reply reply);
+
+   private:
+    struct Job {
+        RenderRequest request;
+        Reply reply;
+        std::chrono::steady_clock::time_point submitted;
+    };
+
+    void work();
+    std::string render(Renderer& renderer, const Job& job);
+
+    ModelCache& cache_;
+    std::vector<std::thread> workers_{};
+    std::queue<Job> jobs_{};
+    std::mutex mutex_{};
+    std::condition_variable cv_{};
+    bool stopping_{false};
+};
+
+namespace RenderRequests {
+// throws std::runtime_error when the line isn't a valid request
+RenderRequest parse(const std::string& line);
+
+void write_ppm(const std::string& filename,
+               const PixelBuffer& pixels,
+               int width,
+               int height);
+}  // namespace RenderRequests
+
+#endif
@@ -4,21 +4,31 @@
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_render.h>
 #include <SDL2/SDL_video.h>
+#include <algorithm>
 #include <array>
+#include <cmath>
+#include <cstddef>
 #include <cstdint>
 #include <functional>
 #include <memory>
+#include <vector>
+#include "aligned.h"
+#include "frame_sink.h"
 #include "model.h"
+#include "shader.h"
 #include "vector.h"
 
+// default output size, this is also the size of the window
 constexpr int SCREEN_WIDTH = 900;
 constexpr int SCREEN_HEIGHT = 900;
 constexpr int DEPTH = 900;
 
-// Color struct with 4 8-bit channels.
-struct Color {
-    int r, g, b, a;
-};
+// smallest fraction of the output size the frame can be rendered at
+constexpr float MIN_RENDER_SCALE = 0.25f;
+
+// size in pixels of the square tiles of the hierarchical depth buffer used for
+// occlusion culling
+constexpr int HIZ_TILE = 16;
 
 // 2D point struct using floats
 struct Point2D {
@@ -32,15 +42,64 @@ struct VertexPair {
 
 using Triangle = std::array<VertexPair, 3>;
 
+// edge function of the edge a -> b at (x, y) from: A Parallel Algorithm for
+// Polygon Rasterization by J. Pineda. It is 0 on the edge and positive on
+// the inner side of a counter clockwise triangle. The edge opposite of a
+// vertex divided by the sum of all three is the weight of the vertex.
+inline float edge_function(const Vector<3>& a,
+                           const Vector<3>& b,
+                           float x,
+                           float y) {
+    return (y - a[Y]) * (a[X] - b[X]) - (x - a[X]) * (a[Y] - b[Y]);
+}
+
+// bytes of heap memory held by the render targets of the renderer
+struct RendererMemory {
+    std::size_t output{};   // framebuffer at the output size and upscale map
+    std::size_t color{};    // color target at the render size
+    std::size_t depth{};    // zbuffer
+    std::size_t culling{};  // occlusion culling tiles and cluster state
+    std::size_t shadows{};  // shadow map
+
+    std::size_t total() const;
+};
+
+// where a screen space triangle can be drawn: the integer sample points in
+// its bounding box, the edge functions at the first of them and twice the
+// signed area of the triangle
+struct TriangleSetup {
+    int min_x, max_x, min_y, max_y;
+    float e23, e31, e12;
+    float area;
+
+    // front facing and covering at least one sample of the bounding box
+    bool drawable() const {
+        return min_x <= max_x && min_y <= max_y && area > 0;
+    }
+};
+
+class ShadowMap;
+
 /* Renderer Singleton Class
  *
  * The renderer singleton is responsible for the underlying SDL renderer and
- * window handles.
+ * window handles. Headless renderers without a window can also be created
+ * on their own, e.g. one per thread to draw several frames at once.
  */
 class Renderer {
    public:
-    // Singleton instance getter
-    static Renderer* GetRenderer();
+    // Singleton instance getter. A headless renderer draws into its
+    // framebuffer without ever opening a window (only the first call decides)
+    static Renderer* GetRenderer(bool headless = false);
+
+    // a separate headless renderer, independent of the singleton
+    static std::unique_ptr<Renderer> CreateHeadlessRenderer();
+
+    // a headless renderer that only keeps a depth buffer, for shaders that
+    // don't write color (e.g. a shadow map). present() does nothing.
+    static std::unique_ptr<Renderer> CreateDepthRenderer();
+
+    ~Renderer();
 
     // blacks out the entire screen and resets the value of z-buffer
     void clear_screen();
@@ -48,13 +107,75 @@ class Renderer {
     // draws a point of given color on the screen
     void draw_point(int x, int y, const Color& clr);
 
-    // render a triangular face with appropriate shading and coloring using
-    // Phong shading.
+    // render a triangular face with flat shading
     void draw_face(const Triangle& v1, const Color& clr);
 
-    // render the given model
+    // rasterize a triangle that went through the vertex stage of the shader
+    template <Shader S>
+    void draw_face(
+        const S& shader,
+        const ShaderUniforms& uniforms,
+        const std::array<ShadedVertex<typename S::Varying>, 3>& triangle);
+
+    // render the given model with flat shading
     void draw_model(const Model& model);
 
+    // render the given model with the shading mode picked at runtime
+    void draw_model(const Model& model, ShadingMode mode);
+
+    // render the given model with the given shader
+    template <Shader S>
+    void draw_model(const Model& model, const S& shader);
+
+    // render the given model with the given shader and uniforms instead of
+    // the ones of the camera
+    template <Shader S>
+    void draw_model(const Model& model,
+                    const S& shader,
+                    const ShaderUniforms& uniforms);
+
+    // the uniforms for drawing with the current camera and light
+    ShaderUniforms uniforms(const Color& clr) const;
+
+    // show the framebuffer in the window (if there is one) and hand it to
+    // the frame sink (if there is one)
+    void present();
+
+    // stream every presented frame to the sink, nullptr stops streaming
+    void set_frame_sink(FrameSink* sink);
+
+    // the last presented frame at the output size. While a frame sink is
+    // set the presented frame is swapped into the sink instead of copied,
+    // and this holds an older frame the sink handed back.
+    const PixelBuffer& framebuffer() const;
+
+    // the depth of the frame being drawn, row by row at the render size.
+    // Larger values are closer, untouched pixels hold the lowest float.
+    const AlignedVector<float>& depth_buffer() const;
+
+    // change the size of the frames handed out by present(). The window (if
+    // there is one) is resized to match.
+    void set_output_size(int width, int height);
+
+    // buffers keep the capacity of the largest output so far, this gives
+    // back what the current output size doesn't need
+    void shrink_to_output();
+    int output_width() const;
+    int output_height() const;
+
+    // render at a fraction of the output size (clamped to
+    // [MIN_RENDER_SCALE, 1]), present() scales the frame up to the output
+    // size. Takes effect with the next clear_screen().
+    void set_render_scale(float scale);
+    float render_scale() const;
+
+    // the size frames are currently rendered at
+    int width() const;
+    int height() const;
+
+    // the memory the render targets hold on to (including unused capacity)
+    RendererMemory memory_usage() const;
+
     // The Renderer should not be cloneable or assignable (singleton)
     Renderer(Renderer& other) = delete;
     void operator=(const Renderer&) = delete;
@@ -65,19 +186,330 @@ class Renderer {
     float yaw{};
     float pitch{};
 
+    // skip clusters of the model hidden behind what has already been drawn.
+    // The clusters that were visible in the previous frame are drawn first
+    // and the rest are tested against the resulting depth.
+    bool occlusion_culling{false};
+
+    // direction of the light for ShadingMode::shadows. Unlike light_dir it
+    // is given in model space, so it stays put while the camera moves and
+    // the shadow map can be reused from frame to frame.
+    Vector<3> shadow_light{-0.4f, -0.6f, -0.7f};
+
    private:
-    Renderer();
-    ~Renderer();
+    Renderer(bool headless, bool depth_only = false);
     static Renderer* renderer_;
     SDL_Renderer* sdl_renderer_{};
     SDL_Window* window_{};
+    SDL_Texture* texture_{};
+
+    // frames are drawn on the CPU into color_ at the render size and then
+    // scaled up into framebuffer_ at the output size to be presented
+    int output_width_{SCREEN_WIDTH};
+    int output_height_{SCREEN_HEIGHT};
+    int width_{SCREEN_WIDTH};
+    int height_{SCREEN_HEIGHT};
+    float render_scale_{1.f};
+    bool depth_only_{false};  // no color_, framebuffer_ or upscale
+    PixelBuffer framebuffer_{};
+    PixelBuffer color_{};
+    FrameSink* sink_{};
+
+    // source column of every output column for the upscale
+    std::vector<int> upscale_columns_{};
 
     // zbuffer allows for keeping track of "layers" when printing multiple
     // colors at the same (x,y) pairs put different depths relative to the
-    // camera.
-    std::array<std::array<float, SCREEN_HEIGHT>, SCREEN_WIDTH> zbuffer_{};
+    // camera. Stored row by row at the render size.
+    AlignedVector<float> zbuffer_{};
+
+    // occlusion culling state: the farthest depth in each HIZ_TILE square of
+    // the zbuffer and which clusters of culled_model_ were visible last frame
+    std::vector<float> hiz_{};
+    const Model* culled_model_{};
+    std::vector<uint8_t> cluster_state_{};
+
+    // created on the first draw with ShadingMode::shadows
+    std::unique_ptr<ShadowMap> shadow_map_{};
+
+    template <Shader S>
+    void draw_faces(const Model& model,
+                    const S& shader,
+                    const ShaderUniforms& u,
+                    int first,
+                    int last);
+
+    TriangleSetup setup_triangle(const Vector<3>& p1,
+                                 const Vector<3>& p2,
+                                 const Vector<3>& p3) const;
+
+    // rasterize a triangle whose setup is already known to be drawable
+    template <Shader S>
+    void draw_face(
+        const S& shader,
+        const ShaderUniforms& uniforms,
+        const std::array<ShadedVertex<typename S::Varying>, 3>& triangle,
+        const TriangleSetup& setup);
+
+    template <Shader S>
+    void draw_sample(
+        const S& shader,
+        const ShaderUniforms& uniforms,
+        const std::array<ShadedVertex<typename S::Varying>, 3>& triangle,
+        const TriangleSetup& setup);
+
+    template <Shader S>
+    void draw_culled(const Model& model,
+                     const S& shader,
+                     const ShaderUniforms& u);
+
+    void draw_shadowed(const Model& model);
+    void resize_targets();
+    void upscale();
+    void build_hiz();
+    bool occluded(const Cluster& cluster, const ShaderUniforms& u) const;
 };
 
+//=============================================================================
+// Shader Pipeline
+//=============================================================================
+template <Shader S>
+void Renderer::draw_model(const Model& model, const S& shader) {
+    draw_model(model, shader, uniforms({255, 255, 255, 255}));
+}
+
+template <Shader S>
+void Renderer::draw_model(const Model& model,
+                          const S& shader,
+                          const ShaderUniforms& u) {
+    if constexpr (S::writes_color) {
+        if (depth_only_)
+            throw "depth only renderers can not draw colors";
+    }
+    if (occlusion_culling)
+        draw_culled(model, shader, u);
+    else
+        draw_faces(model, shader, u, 0, model.nfaces());
+    present();
+}
+
+template <Shader S>
+void Renderer::draw_faces(const Model& model,
+                          const S& shader,
+                          const ShaderUniforms& u,
+                          int first,
+                          int last) {
+    using Vertex = ShadedVertex<typename S::Varying>;
+
+    // corners only go through the vertex stage once a triangle using them
+    // turns out to be drawable. Most triangles of a dense mesh face away or
+    // fall between the samples and never pay for it.
+    struct Corner {
+        Vector<4> pos;  // model space
+        Vertex vertex;
+        bool shaded;
+    };
+    auto corner = [&](const FaceTuple& tuple) {
+        Vector<4> pos{model.vertex(tuple.vertex)};
+        return Corner{pos, {transform_point(u, pos), {}}, false};
+    };
+    auto shade = [&](Corner& c, const FaceTuple& tuple) {
+        if (!c.shaded)
+            c.vertex.var = shader.vertex(u, c.pos, model.normal(tuple.normal));
+        c.shaded = true;
+    };
+
+    for (int i = first; i < last; i++) {
+        const std::vector<FaceTuple>& face{model.face(i)};
+
+        // triangle fan the face polygon (most of the time this is just a
+        // triangle)
+        Corner c1{corner(face[0])};
+        Corner c2{corner(face[1])};
+        for (int j = 2; j < static_cast<int>(face.size()); j++) {
+            Corner c3{corner(face[j])};
+            TriangleSetup setup{
+                setup_triangle(c1.vertex.pos, c2.vertex.pos, c3.vertex.pos)};
+            if (setup.drawable()) {
+                shade(c1, face[0]);
+                shade(c2, face[j - 1]);
+                shade(c3, face[j]);
+                draw_face(shader, u, {c1.vertex, c2.vertex, c3.vertex}, setup);
+            }
+            c2 = c3;
+        }
+    }
+}
+
+// Two pass occlusion culling. Clusters that were visible in the last frame
+// are drawn first, since the camera barely moves between frames they cover
+// most of what ends up on screen. Every other cluster is then tested against
+// the depth of this frame, so nothing can pop in even when last frame's guess
+// was wrong.
+template <Shader S>
+void Renderer::draw_culled(const Model& model,
+                           const S& shader,
+                           const ShaderUniforms& u) {
+    // bit 0: visible last frame, bit 1: drawn this frame
+    constexpr uint8_t VISIBLE = 1, DRAWN = 2;
+
+    const std::vector<Cluster>& clusters{model.clusters()};
+    if (culled_model_ != &model || cluster_state_.size() != clusters.size()) {
+        culled_model_ = &model;
+        cluster_state_.assign(clusters.size(), VISIBLE);
+    }
+
+    for (int c = 0; c < static_cast<int>(clusters.size()); c++) {
+        cluster_state_[c] &= VISIBLE;
+        if (cluster_state_[c] & VISIBLE) {
+            draw_faces(model, shader, u, clusters[c].first_face,
+                       clusters[c].first_face + clusters[c].nfaces);
+            cluster_state_[c] |= DRAWN;
+        }
+    }
+
+    build_hiz();
+    for (int c = 0; c < static_cast<int>(clusters.size()); c++) {
+        if (!(cluster_state_[c] & DRAWN) && !occluded(clusters[c], u)) {
+            draw_faces(model, shader, u, clusters[c].first_face,
+                       clusters[c].first_face + clusters[c].nfaces);
+            cluster_state_[c] |= DRAWN;
+        }
+    }
+
+    // clusters from the first pass that are already hidden are not drawn
+    // first next frame. Testing them against the depth before the second
+    // pass only keeps a few too many, which costs time but never pixels.
+    for (int c = 0; c < static_cast<int>(clusters.size()); c++) {
+        bool drawn{(cluster_state_[c] & DRAWN) != 0};
+        bool hidden{(cluster_state_[c] & VISIBLE) && occluded(clusters[c], u)};
+        cluster_state_[c] = drawn && !hidden ? VISIBLE : 0;
+    }
+}
+
+template <Shader S>
+void Renderer::draw_face(
+    const S& shader,
+    const ShaderUniforms& uniforms,
+    const std::array<ShadedVertex<typename S::Varying>, 3>& triangle) {
+    TriangleSetup setup{
+        setup_triangle(triangle[0].pos, triangle[1].pos, triangle[2].pos)};
+    if (setup.drawable())
+        draw_face(shader, uniforms, triangle, setup);
+}
+
+// The triangle is rasterized with the edge functions. They are linear so they
+// (and therefore the barycentric weights and depth) are stepped
+// incrementally across the bounding box.
+template <Shader S>
+void Renderer::draw_face(
+    const S& shader,
+    const ShaderUniforms& uniforms,
+    const std::array<ShadedVertex<typename S::Varying>, 3>& triangle,
+    const TriangleSetup& setup) {
+    const Vector<3>& p1 = triangle[0].pos;
+    const Vector<3>& p2 = triangle[1].pos;
+    const Vector<3>& p3 = triangle[2].pos;
+
+    // on dense meshes most of the drawn triangles are this small, they skip
+    // the setup for stepping across the bounding box
+    if (setup.min_x == setup.max_x && setup.min_y == setup.max_y) {
+        draw_sample(shader, uniforms, triangle, setup);
+        return;
+    }
+
+    float e23_row = setup.e23, e31_row = setup.e31, e12_row = setup.e12;
+    float inv_area = 1 / setup.area;
+
+    // change of the edge functions for a step in x or y
+    float e23_dx = p3[Y] - p2[Y], e23_dy = p2[X] - p3[X];
+    float e31_dx = p1[Y] - p3[Y], e31_dy = p3[X] - p1[X];
+    float e12_dx = p2[Y] - p1[Y], e12_dy = p1[X] - p2[X];
+
+    typename S::Face face{shader.face(
+        uniforms, {triangle[0].var, triangle[1].var, triangle[2].var})};
+
+    for (int y = setup.min_y; y <= setup.max_y; y++) {
+        float e23 = e23_row, e31 = e31_row, e12 = e12_row;
+        float* depth = &zbuffer_[y * width_];
+        for (int x = setup.min_x; x <= setup.max_x; x++) {
+            if (e23 >= 0 && e31 >= 0 && e12 >= 0) {
+                float w1 = e23 * inv_area;
+                float w2 = e31 * inv_area;
+                float w3 = e12 * inv_area;
+                float z = w1 * p1[Z] + w2 * p2[Z] + w3 * p3[Z];
+                if (z >= depth[x]) {
+                    depth[x] = z;
+                    if constexpr (S::writes_color)
+                        draw_point(x, y, shader.fragment(face, w1, w2, w3));
+                }
+            }
+            e23 += e23_dx;
+            e31 += e31_dx;
+            e12 += e12_dx;
+        }
+        e23_row += e23_dy;
+        e31_row += e31_dy;
+        e12_row += e12_dy;
+    }
+}
+
+inline TriangleSetup Renderer::setup_triangle(const Vector<3>& p1,
+                                             const Vector<3>& p2,
+                                             const Vector<3>& p3) const {
+    TriangleSetup setup{};
+    setup.min_x = std::max(
+        static_cast<int>(std::ceil(std::min({p1[X], p2[X], p3[X]}))), 0);
+    setup.max_x = std::min(
+        static_cast<int>(std::floor(std::max({p1[X], p2[X], p3[X]}))),
+        width_ - 1);
+    setup.min_y = std::max(
+        static_cast<int>(std::ceil(std::min({p1[Y], p2[Y], p3[Y]}))), 0);
+    setup.max_y = std::min(
+        static_cast<int>(std::floor(std::max({p1[Y], p2[Y], p3[Y]}))),
+        height_ - 1);
+    if (setup.min_x > setup.max_x || setup.min_y > setup.max_y)
+        return setup;
+
+    // only triangles wound towards the camera have a positive area
+    setup.e23 = edge_function(p2, p3, setup.min_x, setup.min_y);
+    setup.e31 = edge_function(p3, p1, setup.min_x, setup.min_y);
+    setup.e12 = edge_function(p1, p2, setup.min_x, setup.min_y);
+    setup.area = setup.e23 + setup.e31 + setup.e12;
+    return setup;
+}
+
+// Triangles covering a single sample are tested on their own. The face stage
+// only runs when the sample passes the depth test, so the many triangles of
+// a dense mesh that end up hidden never pay for it.
+template <Shader S>
+void Renderer::draw_sample(
+    const S& shader,
+    const ShaderUniforms& uniforms,
+    const std::array<ShadedVertex<typename S::Varying>, 3>& triangle,
+    const TriangleSetup& setup) {
+    if (setup.e23 < 0 || setup.e31 < 0 || setup.e12 < 0)
+        return;
+
+    int x = setup.min_x, y = setup.min_y;
+    float inv_area = 1 / setup.area;
+    float w1 = setup.e23 * inv_area;
+    float w2 = setup.e31 * inv_area;
+    float w3 = setup.e12 * inv_area;
+    float z = w1 * triangle[0].pos[Z] + w2 * triangle[1].pos[Z] +
+              w3 * triangle[2].pos[Z];
+    float& depth = zbuffer_[y * width_ + x];
+    if (z < depth)
+        return;
+
+    depth = z;
+    if constexpr (S::writes_color) {
+        typename S::Face face{shader.face(
+            uniforms, {triangle[0].var, triangle[1].var, triangle[2].var})};
+        draw_point(x, y, shader.fragment(face, w1, w2, w3));
+    }
+}
+
 bool InsideTriangle(const Triangle& triangle, float x, float y);
 
 // given 3 points to define a plane return a function that finds a solution
@@ -0,0 +1,93 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "memory_stats.h"
+#include "model.h"
+#include "renderer.h"
+
+// A scripted scene for the replay harness. The camera orbits the model from
+// the start to the end angles over the course of the scene.
+//
+// Scenes are read from plain text scripts, one setting per line:
+//
+//     scene head-orbit
+//     model ../obj_files/head.obj
+//     optimize
+//     compact 16
+//     resolution 900 900
+//     target 8
+//     shading flat
+//     occlusion
+//     frames 500
+//     yaw 0 360
+//     pitch 0 0
+//     allocations 0
+//
+// shading is one of flat, gouraud, phong, depth, normals or shadows. target
+// is a frame time in milliseconds that the render scale is adjusted to meet,
+// the frames are still scaled up to the resolution. allocations fails the
+// run when any frame but the first makes more heap allocations than given.
+// Every "scene" line starts a new scene, model paths are relative to the
+// script, angles are given in degrees and anything after a '#' is a comment.
+struct Scene {
+    std::string name{};
+    std::string model{};
+    ModelOptions options{};
+    int width{SCREEN_WIDTH};
+    int height{SCREEN_HEIGHT};
+    float target_ms{0.f};  // 0 renders every frame at full resolution
+    std::string shading{"flat"};
+    bool occlusion_culling{false};
+    int frames{1000};
+    float yaw_start{0.f};
+    float yaw_end{360.f};
+    float pitch_start{0.f};
+    float pitch_end{0.f};
+    int max_allocations{-1};  // -1 doesn't check
+};
+
+// everything measured while replaying a scene
+struct SceneRun {
+    std::vector<float> frame_times{};
+    std::vector<uint64_t> frame_allocations{};
+    AllocationStats load{};  // made while loading the model
+    ModelMemory model{};
+    RendererMemory renderer{};
+};
+
+// frame time statistics of a scene, times are in milliseconds
+struct FrameStats {
+    std::string scene{};
+    int frames{};
+    float p50{};
+    float p95{};
+    float p99{};
+    float max{};
+    float fps{};  // frames per second over the whole scene
+
+    // most heap allocations made by a frame, the first frame sets up the
+    // renderer and is not counted
+    uint64_t allocations{};
+};
+
+namespace Replay {
+std::vector<Scene> parse_scenes(const std::string& filename);
+
+// render the scene headlessly and measure every frame
+SceneRun run_scene(const Scene& scene);
+
+FrameStats summarize(const std::string& scene, const SceneRun& run);
+
+// nearest-rank percentile of sorted values
+float percentile(const std::vector<float>& sorted, float p);
+
+// baselines are stored one scene per line as: name p50 p95 p99 max fps
+std::vector<FrameStats> load_baseline(const std::string& filename);
+void save_baseline(const std::string& filename,
+                   const std::vector<FrameStats>& stats);
+}  // namespace Replay
+
+#endif
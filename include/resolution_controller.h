@@ -0,0 +1,32 @@
+#ifndef RESOLUTION_CONTROLLER_H
+#define RESOLUTION_CONTROLLER_H
+
+#include "renderer.h"
+
+/* Dynamic Resolution Controller
+ *
+ * Picks the render scale for the next frame from the measured frame times so
+ * that frames take about the target time. The cost of a frame is mostly
+ * proportional to the number of pixels, so the scale moves with the square
+ * root of how far off the (smoothed) frame time is.
+ */
+class ResolutionController {
+   public:
+    explicit ResolutionController(float target_ms,
+                                  float min_scale = MIN_RENDER_SCALE,
+                                  float max_scale = 1.f);
+
+    // feed the time the last frame took and get the scale for the next one
+    float update(float frame_ms);
+
+    float scale() const;
+
+   private:
+    float target_ms_;
+    float min_scale_;
+    float max_scale_;
+    float scale_;
+    float average_ms_{};  // exponential moving average, 0 until the 1st frame
+};
+
+#endif
@@ -0,0 +1,214 @@
+#ifndef SHADER_H
+#define SHADER_H
+
+#include <algorithm>
+#include <array>
+#include <concepts>
+#include <optional>
+#include <string_view>
+#include "vector.h"
+
+// Color struct with 4 8-bit channels.
+struct Color {
+    int r, g, b, a;
+};
+
+// values shared by every vertex and pixel of a draw call
+struct ShaderUniforms {
+    Matrix<4, 4> transform{};         // model space -> screen space
+    Matrix<4, 4> normal_transform{};  // inverse transpose of transform
+    Vector<3> light_dir{};
+    Color color{};
+};
+
+// a corner of a screen space triangle: its position and the output of the
+// vertex stage, whatever the shader wants interpolated across the triangle
+template <typename Varying>
+struct ShadedVertex {
+    Vector<3> pos;
+    Varying var;
+};
+
+/* Shader Policies
+ *
+ * The rasterizer is a template over the shader so that every shading mode
+ * gets its own inlined inner loop. The corners are transformed to screen
+ * space by the pipeline, a shader has three stages on top of that:
+ *
+ *   vertex:   runs for the corners of triangles that cover a sample and
+ *             produces the Varying of the corner from its model space
+ *             position and normal
+ *   face:     runs once per triangle, does the per triangle setup
+ *   fragment: runs for every covered pixel with the barycentric weights
+ *             of the pixel and returns its color
+ *
+ * Shaders with writes_color set to false only update the depth buffer and
+ * never have their fragment stage called.
+ */
+template <typename S>
+concept Shader = requires(const S shader,
+                          const ShaderUniforms& uniforms,
+                          const Vector<4>& pos,
+                          const Vector<4>& normal,
+                          const std::array<typename S::Varying, 3>& vars,
+                          const typename S::Face& face,
+                          float w) {
+    { S::writes_color } -> std::convertible_to<bool>;
+    {
+        shader.vertex(uniforms, pos, normal)
+    } -> std::same_as<typename S::Varying>;
+    { shader.face(uniforms, vars) } -> std::same_as<typename S::Face>;
+    { shader.fragment(face, w, w, w) } -> std::same_as<Color>;
+};
+
+// transform a model space normal into screen space
+inline Vector<3> transform_normal(const ShaderUniforms& uniforms,
+                                  const Vector<4>& normal) {
+    return (uniforms.normal_transform * normal).dehomogenize().normalize();
+}
+
+inline Vector<3> transform_point(const ShaderUniforms& uniforms,
+                                 const Vector<4>& pos) {
+    return (uniforms.transform * pos).dehomogenize();
+}
+
+inline Color scale_color(const Color& clr, float intensity) {
+    intensity = std::clamp(intensity, 0.f, 1.f);
+    return {static_cast<int>(clr.r * intensity),
+            static_cast<int>(clr.g * intensity),
+            static_cast<int>(clr.b * intensity), 255};
+}
+
+// one color per triangle lit by the average of its vertex normals
+struct FlatShader {
+    using Varying = Vector<3>;
+    using Face = Color;
+    static constexpr bool writes_color = true;
+
+    Varying vertex(const ShaderUniforms& uniforms,
+                   const Vector<4>&,
+                   const Vector<4>& normal) const {
+        return transform_normal(uniforms, normal);
+    }
+
+    Face face(const ShaderUniforms& uniforms,
+              const std::array<Varying, 3>& vars) const {
+        Vector<3> norm{1 / 3.f * (vars[0] + vars[1] + vars[2])};
+        return scale_color(uniforms.color,
+                           dot_product(uniforms.light_dir, norm.normalize()));
+    }
+
+    Color fragment(const Face& face, float, float, float) const {
+        return face;
+    }
+};
+
+// lighting is computed at the vertices and interpolated across the triangle
+struct GouraudShader {
+    using Varying = float;
+    struct Face {
+        Color color;
+        std::array<float, 3> intensity;
+    };
+    static constexpr bool writes_color = true;
+
+    Varying vertex(const ShaderUniforms& uniforms,
+                   const Vector<4>&,
+                   const Vector<4>& normal) const {
+        return dot_product(uniforms.light_dir,
+                           transform_normal(uniforms, normal));
+    }
+
+    Face face(const ShaderUniforms& uniforms,
+              const std::array<Varying, 3>& vars) const {
+        return {uniforms.color, vars};
+    }
+
+    Color fragment(const Face& face, float w0, float w1, float w2) const {
+        return scale_color(face.color, w0 * face.intensity[0] +
+                                           w1 * face.intensity[1] +
+                                           w2 * face.intensity[2]);
+    }
+};
+
+// the normal is interpolated across the triangle and lit at every pixel
+struct PhongShader {
+    using Varying = Vector<3>;
+    struct Face {
+        Color color;
+        Vector<3> light_dir;
+        std::array<Vector<3>, 3> normals;
+    };
+    static constexpr bool writes_color = true;
+
+    Varying vertex(const ShaderUniforms& uniforms,
+                   const Vector<4>&,
+                   const Vector<4>& normal) const {
+        return transform_normal(uniforms, normal);
+    }
+
+    Face face(const ShaderUniforms& uniforms,
+              const std::array<Varying, 3>& vars) const {
+        return {uniforms.color, uniforms.light_dir, vars};
+    }
+
+    Color fragment(const Face& face, float w0, float w1, float w2) const {
+        Vector<3> norm{w0 * face.normals[0] + w1 * face.normals[1] +
+                       w2 * face.normals[2]};
+        return scale_color(face.color,
+                           dot_product(face.light_dir, norm.normalize()));
+    }
+};
+
+// only fills the depth buffer
+struct DepthShader {
+    struct Varying {};
+    struct Face {};
+    static constexpr bool writes_color = false;
+
+    Varying vertex(const ShaderUniforms&,
+                   const Vector<4>&,
+                   const Vector<4>&) const {
+        return {};
+    }
+
+    Face face(const ShaderUniforms&, const std::array<Varying, 3>&) const {
+        return {};
+    }
+
+    Color fragment(const Face&, float, float, float) const { return {}; }
+};
+
+// shows the interpolated screen space normal as a color
+struct NormalShader {
+    using Varying = Vector<3>;
+    using Face = std::array<Vector<3>, 3>;
+    static constexpr bool writes_color = true;
+
+    Varying vertex(const ShaderUniforms& uniforms,
+                   const Vector<4>&,
+                   const Vector<4>& normal) const {
+        return transform_normal(uniforms, normal);
+    }
+
+    Face face(const ShaderUniforms&, const std::array<Varying, 3>& vars) const {
+        return vars;
+    }
+
+    Color fragment(const Face& face, float w0, float w1, float w2) const {
+        Vector<3> norm{w0 * face[0] + w1 * face[1] + w2 * face[2]};
+        norm = norm.normalize();
+        return {static_cast<int>((norm[X] * 0.5f + 0.5f) * 255),
+                static_cast<int>((norm[Y] * 0.5f + 0.5f) * 255),
+                static_cast<int>((norm[Z] * 0.5f + 0.5f) * 255), 255};
+    }
+};
+
+// the shading modes that can be picked at runtime. The choice is made once
+// per draw call, not per pixel. shadows lights the model from
+// Renderer::shadow_light and shadows it with a shadow map.
+enum class ShadingMode { flat, gouraud, phong, depth, normals, shadows };
+
+std::optional<ShadingMode> parse_shading_mode(std::string_view name);
+
+#endif
@@ -0,0 +1,104 @@
+#ifndef SHADOW_MAP_H
+#define SHADOW_MAP_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include "model.h"
+#include "renderer.h"
+#include "shader.h"
+#include "vector.h"
+
+// width and height of the shadow map in texels
+constexpr int SHADOW_MAP_SIZE = 1024;
+
+/* Shadow Map
+ *
+ * The depth of a model as seen from a directional light, drawn with the
+ * same rasterizer as everything else into a depth only renderer of its own.
+ * The light looks at the bounding box of the model through an orthographic
+ * projection.
+ *
+ * Only the faces turned away from the light are drawn. Every surface that
+ * is lit lies in front of the back of its own object, so it never shadows
+ * itself and only needs a small bias.
+ *
+ * Drawing the map is skipped as long as the light and the model stay the
+ * same, which is the case when only the camera moves.
+ */
+class ShadowMap {
+   public:
+    explicit ShadowMap(int size = SHADOW_MAP_SIZE);
+
+    // redraw the map if the model or the light direction (in model space)
+    // changed since the last call. Returns whether it was redrawn.
+    bool update(const Model& model, const Vector<3>& light_dir);
+
+    // model space -> shadow map, x and y in texels and z the depth (larger
+    // is closer to the light)
+    const Matrix<4, 4>& transform() const;
+
+    // the fraction of the 3x3 texels around the point (in shadow map space)
+    // that the light reaches, i.e. percentage closer filtering
+    float visibility(const Vector<3>& p) const;
+
+    std::size_t memory_usage() const;
+
+   private:
+    int size_;
+    std::unique_ptr<Renderer> renderer_;
+    Matrix<4, 4> transform_{};
+    float bias_{};
+
+    // what the map was drawn for
+    uint64_t revision_{};
+    Vector<3> light_dir_{};
+};
+
+// lights the model from a direction in model space and looks up the shadow
+// map at every pixel. Surfaces in shadow only get the ambient light.
+struct ShadowShader {
+    const ShadowMap* shadow_map;
+    Vector<3> to_light;  // model space, normalized
+
+    struct Varying {
+        Vector<3> normal;  // model space
+        Vector<3> shadow;  // shadow map space
+    };
+    struct Face {
+        Color color;
+        std::array<Varying, 3> corners;
+    };
+    static constexpr bool writes_color = true;
+    static constexpr float ambient = 0.15f;
+
+    Varying vertex(const ShaderUniforms&,
+                   const Vector<4>& pos,
+                   const Vector<4>& normal) const {
+        return {Vector<3>{normal[X], normal[Y], normal[Z]},
+                (shadow_map->transform() * pos).dehomogenize()};
+    }
+
+    Face face(const ShaderUniforms& uniforms,
+              const std::array<Varying, 3>& vars) const {
+        return {uniforms.color, vars};
+    }
+
+    Color fragment(const Face& face, float w0, float w1, float w2) const {
+        const std::array<Varying, 3>& c{face.corners};
+        Vector<3> norm{w0 * c[0].normal + w1 * c[1].normal +
+                       w2 * c[2].normal};
+        float diffuse{dot_product(to_light, norm.normalize())};
+        if (diffuse <= 0)
+            return scale_color(face.color, ambient);
+
+        Vector<3> shadow{w0 * c[0].shadow + w1 * c[1].shadow +
+                         w2 * c[2].shadow};
+        return scale_color(face.color,
+                           ambient + (1 - ambient) * diffuse *
+                                         shadow_map->visibility(shadow));
+    }
+};
+
+#endif
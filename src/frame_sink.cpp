@@ -0,0 +1,158 @@
+#include "frame_sink.h"
+
+#include <sys/stat.h>
+#include <algorithm>
+#include <atomic>
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+FrameSink::FrameSink(const std::string& path,
+                     int width,
+                     int height,
+                     FrameFormat format,
+                     int fps,
+                     int nslots)
+    : width_{width},
+      height_{height},
+      format_{format},
+      slots_(nslots, PixelBuffer(width * height)) {
+    out_ = path == "-" ? stdout : std::fopen(path.c_str(), "wb");
+    if (out_ == nullptr)
+        throw std::runtime_error("could not open frame output " + path);
+
+    // a reader closing the pipe would kill the process with SIGPIPE, with
+    // the signal ignored the write fails and the sink reports failed()
+    struct stat info{};
+    if (fstat(fileno(out_), &info) == 0 &&
+        (S_ISFIFO(info.st_mode) || S_ISSOCK(info.st_mode)))
+        std::signal(SIGPIPE, SIG_IGN);
+
+    if (format_ == FrameFormat::y4m) {
+        std::fprintf(out_, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C420jpeg\n",
+                     width_, height_, fps);
+    }
+
+    writer_ = std::thread{&FrameSink::write_frames, this};
+}
+
+FrameSink::~FrameSink() {
+    head_.fetch_or(CLOSED, std::memory_order_release);
+    head_.notify_one();
+    writer_.join();
+
+    if (out_ == stdout)
+        std::fflush(out_);
+    else
+        std::fclose(out_);
+}
+
+void FrameSink::submit(PixelBuffer& frame) {
+    uint64_t head{head_.load(std::memory_order_relaxed)};
+
+    // wait for the writer to free up a slot if the ring is full
+    uint64_t tail{tail_.load(std::memory_order_acquire)};
+    while (head - tail == slots_.size()) {
+        tail_.wait(tail, std::memory_order_acquire);
+        tail = tail_.load(std::memory_order_acquire);
+    }
+
+    std::swap(frame, slots_[head % slots_.size()]);
+    head_.store(head + 1, std::memory_order_release);
+    head_.notify_one();
+}
+
+bool FrameSink::failed() const {
+    return failed_.load(std::memory_order_relaxed);
+}
+
+void FrameSink::write_frames() {
+    uint64_t tail{0};
+    for (;;) {
+        uint64_t head{head_.load(std::memory_order_acquire)};
+        if ((head & ~CLOSED) == tail) {
+            if (head & CLOSED)
+                return;
+            head_.wait(head, std::memory_order_acquire);
+            continue;
+        }
+
+        // once the output fails the frames are dropped so the render thread
+        // never gets stuck on a full ring
+        const PixelBuffer& frame{slots_[tail % slots_.size()]};
+        if (!failed()) {
+            if (format_ == FrameFormat::rgba)
+                write_rgba(frame);
+            else
+                write_y4m(frame);
+            if (std::ferror(out_))
+                failed_.store(true, std::memory_order_relaxed);
+        }
+
+        tail_.store(++tail, std::memory_order_release);
+        tail_.notify_one();
+    }
+}
+
+void FrameSink::write_rgba(const PixelBuffer& frame) {
+    staging_.resize(frame.size() * 4);
+    for (int i = 0; i < static_cast<int>(frame.size()); i++) {
+        uint32_t pixel{frame[i]};
+        staging_[4 * i] = pixel >> 16 & 0xff;
+        staging_[4 * i + 1] = pixel >> 8 & 0xff;
+        staging_[4 * i + 2] = pixel & 0xff;
+        staging_[4 * i + 3] = pixel >> 24;
+    }
+    std::fwrite(staging_.data(), 1, staging_.size(), out_);
+}
+
+// BT.601 studio swing conversion with the chroma averaged over 2x2 blocks
+void FrameSink::write_y4m(const PixelBuffer& frame) {
+    int chroma_width{(width_ + 1) / 2};
+    int chroma_height{(height_ + 1) / 2};
+    int luma_size{width_ * height_};
+    int chroma_size{chroma_width * chroma_height};
+    staging_.resize(luma_size + 2 * chroma_size);
+
+    uint8_t* luma{staging_.data()};
+    uint8_t* cb{luma + luma_size};
+    uint8_t* cr{cb + chroma_size};
+
+    for (int i = 0; i < luma_size; i++) {
+        int r = frame[i] >> 16 & 0xff;
+        int g = frame[i] >> 8 & 0xff;
+        int b = frame[i] & 0xff;
+        luma[i] =
+            static_cast<uint8_t>(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+    }
+
+    for (int cy = 0; cy < chroma_height; cy++) {
+        for (int cx = 0; cx < chroma_width; cx++) {
+            int r{0}, g{0}, b{0}, n{0};
+            for (int y = 2 * cy; y < std::min(2 * cy + 2, height_); y++) {
+                for (int x = 2 * cx; x < std::min(2 * cx + 2, width_); x++) {
+                    uint32_t pixel{frame[y * width_ + x]};
+                    r += pixel >> 16 & 0xff;
+                    g += pixel >> 8 & 0xff;
+                    b += pixel & 0xff;
+                    n++;
+                }
+            }
+            r /= n;
+            g /= n;
+            b /= n;
+            cb[cy * chroma_width + cx] = static_cast<uint8_t>(
+                ((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+            cr[cy * chroma_width + cx] = static_cast<uint8_t>(
+                ((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+        }
+    }
+
+    std::fputs("FRAME\n", out_);
+    std::fwrite(staging_.data(), 1, staging_.size(), out_);
+}
@@ -1,47 +1,179 @@
 #include <math.h>
+#include <algorithm>
 #include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
 #include <iostream>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "frame_sink.h"
 #include "model.h"
+#include "model_loader.h"
 #include "renderer.h"
+#include "resolution_controller.h"
+#include "shader.h"
 #include "vector.h"
 
 #define DEFAULT_MODEL "obj_files/head.obj"
 
+static int usage() {
+    std::cerr << "usage: renderer [--headless] [--output <file|->] "
+                 "[--format rgba|y4m]\n"
+                 "                [--resolution WIDTHxHEIGHT] "
+                 "[--target-ms <ms>] [--shading <mode>]\n"
+                 "                [--occlusion-culling] [--optimize] "
+                 "[--compact] [--crease <degrees>]\n"
+                 "                [model.obj...]\n";
+    return 2;
+}
+
+// the whole argument has to be a number
+static std::optional<float> parse_float(const char* arg) {
+    char* end{};
+    float value{std::strtof(arg, &end)};
+    if (end == arg || *end != '\0' || !std::isfinite(value))
+        return std::nullopt;
+    return value;
+}
+
 int main(int argc, char** argv) {
-    char const* model_name{DEFAULT_MODEL};
-    if (argc == 2)
-        model_name = argv[1];
+    // every model given on the command line gets an equal share of the frames
+    std::vector<char const*> model_names{};
+    ModelOptions options{};
+    ShadingMode mode{ShadingMode::flat};
+    std::optional<std::string> output{};
+    FrameFormat format{FrameFormat::rgba};
+    bool headless{false};
+    bool occlusion_culling{false};
+    int width{SCREEN_WIDTH};
+    int height{SCREEN_HEIGHT};
+    std::optional<float> target_ms{};
+    for (int i = 1; i < argc; i++) {
+        if (std::string_view{argv[i]} == "--optimize")
+            options.optimize = true;
+        else if (std::string_view{argv[i]} == "--shading" && i + 1 < argc)
+            mode = parse_shading_mode(argv[++i]).value_or(ShadingMode::flat);
+        else if (std::string_view{argv[i]} == "--compact")
+            options.compact = true;
+        else if (std::string_view{argv[i]} == "--crease" && i + 1 < argc) {
+            std::optional<float> degrees{parse_float(argv[++i])};
+            if (!degrees || *degrees < 0)
+                return usage();
+            options.crease_angle = *degrees * M_PIf / 180.f;
+        } else if (std::string_view{argv[i]} == "--output" && i + 1 < argc)
+            output = argv[++i];
+        else if (std::string_view{argv[i]} == "--format" && i + 1 < argc)
+            format = std::string_view{argv[++i]} == "y4m" ? FrameFormat::y4m
+                                                          : FrameFormat::rgba;
+        else if (std::string_view{argv[i]} == "--headless")
+            headless = true;
+        else if (std::string_view{argv[i]} == "--occlusion-culling")
+            occlusion_culling = true;
+        else if (std::string_view{argv[i]} == "--resolution" && i + 1 < argc) {
+            if (std::sscanf(argv[++i], "%dx%d", &width, &height) != 2 ||
+                width <= 0 || height <= 0)
+                return usage();
+        } else if (std::string_view{argv[i]} == "--target-ms" && i + 1 < argc) {
+            target_ms = parse_float(argv[++i]);
+            if (!target_ms || *target_ms <= 0)
+                return usage();
+        } else
+            model_names.push_back(argv[i]);
+    }
+    if (model_names.empty())
+        model_names.push_back(DEFAULT_MODEL);
+
+    // keep stdout clean when the frames are streamed there
+    std::ostream& report{output == "-" ? std::cerr : std::cout};
 
     try {
         // let's time the execution time
         auto start_time = std::chrono::high_resolution_clock::now();
 
         int frames{1000};
-        Model model{model_name};
-        Renderer* renderer = Renderer::GetRenderer();
+        int frames_per_model{
+            std::max(frames / static_cast<int>(model_names.size()), 1)};
+
+        // the first model has to be there before anything can be drawn, the
+        // rest are loaded in the background while the previous one is shown
+        ModelLoader loader{};
+        ModelSlot slot{};
+        slot.request(loader.load(model_names[0], options));
+        slot.pending()->get();
+        slot.poll();
+
+        Renderer* renderer = Renderer::GetRenderer(headless);
+        renderer->set_output_size(width, height);
+
+        // with a target frame time the render scale follows the load
+        std::optional<ResolutionController> resolution{};
+        if (target_ms)
+            resolution.emplace(*target_ms);
+
+        // frames are streamed out on a writer thread
+        std::unique_ptr<FrameSink> sink{};
+        if (output) {
+            sink = std::make_unique<FrameSink>(
+                *output, renderer->output_width(), renderer->output_height(),
+                format);
+            renderer->set_frame_sink(sink.get());
+        }
+
+        renderer->occlusion_culling = occlusion_culling;
         renderer->yaw = 0;
         renderer->pitch = 0;
         for (int i = 0; i < frames; i++) {
             renderer->yaw = 4 * M_PI_2f * static_cast<float>(i) /
                             static_cast<float>(frames);
 
-            renderer->draw_model(model);
+            int next{i / frames_per_model + 1};
+            if (i % frames_per_model == 0 &&
+                next < static_cast<int>(model_names.size())) {
+                slot.request(loader.load(model_names[next], options));
+            }
+            slot.poll();
 
+            auto frame_start = std::chrono::steady_clock::now();
+            renderer->draw_model(*slot.current(), mode);
+            // e.g. the reader of the pipe went away
+            if (sink && sink->failed())
+                break;
+
+            if (resolution) {
+                std::chrono::duration<float, std::milli> frame_time{
+                    std::chrono::steady_clock::now() - frame_start};
+                renderer->set_render_scale(
+                    resolution->update(frame_time.count()));
+            }
             renderer->clear_screen();
         }
+        renderer->set_frame_sink(nullptr);
+        if (sink && sink->failed()) {
+            std::cerr << "could not write frames to " << *output << "\n";
+            return 1;
+        }
+        sink.reset();
+
         auto stop_time = std::chrono::high_resolution_clock::now();
         long milliseconds_elapsed =
             std::chrono::duration_cast<std::chrono::milliseconds>(stop_time -
                                                                   start_time)
                 .count();
-        std::cout << "It took " << milliseconds_elapsed
-                  << " milliseconds to print " << frames << " frames ("
-                  << static_cast<float>(frames) /
-                         static_cast<float>(milliseconds_elapsed) * 1000.f
-                  << " FPS)\n";
+        report << "It took " << milliseconds_elapsed
+               << " milliseconds to print " << frames << " frames ("
+               << static_cast<float>(frames) /
+                      static_cast<float>(milliseconds_elapsed) * 1000.f
+               << " FPS)\n";
 
     } catch (const char* ex) {
-        std::cout << ex << "\n";
+        std::cerr << ex << "\n";
+    } catch (const std::exception& ex) {
+        std::cerr << ex.what() << "\n";
     }
 
     return 0;
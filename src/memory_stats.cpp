@@ -0,0 +1,104 @@
+#include "memory_stats.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+namespace {
+std::atomic<uint64_t> allocation_count{0};
+std::atomic<uint64_t> allocation_bytes{0};
+std::atomic<MemoryStats::AllocationHook> allocation_hook{nullptr};
+
+void count_allocation(std::size_t size) {
+    allocation_count.fetch_add(1, std::memory_order_relaxed);
+    allocation_bytes.fetch_add(size, std::memory_order_relaxed);
+    if (MemoryStats::AllocationHook hook{
+            allocation_hook.load(std::memory_order_relaxed)})
+        hook(size);
+}
+
+void* allocate(std::size_t size) {
+    count_allocation(size);
+    if (void* p{std::malloc(size == 0 ? 1 : size)})
+        return p;
+    throw std::bad_alloc{};
+}
+
+void* allocate(std::size_t size, std::align_val_t alignment) {
+    count_allocation(size);
+    // aligned_alloc wants the size to be a multiple of the alignment
+    std::size_t align{static_cast<std::size_t>(alignment)};
+    std::size_t rounded{(size + align - 1) / align * align};
+    if (void* p{std::aligned_alloc(align, rounded == 0 ? align : rounded)})
+        return p;
+    throw std::bad_alloc{};
+}
+}  // namespace
+
+AllocationStats MemoryStats::allocations() {
+    return {allocation_count.load(std::memory_order_relaxed),
+            allocation_bytes.load(std::memory_order_relaxed)};
+}
+
+void MemoryStats::set_allocation_hook(AllocationHook hook) {
+    allocation_hook.store(hook, std::memory_order_relaxed);
+}
+
+AllocationScope::AllocationScope() : start_{MemoryStats::allocations()} {}
+
+AllocationStats AllocationScope::stats() const {
+    AllocationStats now{MemoryStats::allocations()};
+    return {now.count - start_.count, now.bytes - start_.bytes};
+}
+
+// the replacements of the global allocation functions, the nothrow versions
+// fall back on these
+void* operator new(std::size_t size) {
+    return allocate(size);
+}
+
+void* operator new[](std::size_t size) {
+    return allocate(size);
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment) {
+    return allocate(size, alignment);
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment) {
+    return allocate(size, alignment);
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void* p, std::size_t) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, std::align_val_t) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void* p, std::align_val_t) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void* p, std::size_t, std::align_val_t) noexcept {
+    std::free(p);
+}
@@ -0,0 +1,195 @@
+#include "mesh_optimizer.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <numeric>
+#include <vector>
+#include "vector.h"
+
+namespace {
+// spread the lower 10 bits of v so that there are two zero bits between each
+// of them (used for building 30-bit Morton codes)
+uint32_t spread_bits(uint32_t v) {
+    v &= 0x3ff;
+    v = (v | (v << 16)) & 0x030000ff;
+    v = (v | (v << 8)) & 0x0300f00f;
+    v = (v | (v << 4)) & 0x030c30c3;
+    v = (v | (v << 2)) & 0x09249249;
+    return v;
+}
+
+uint32_t morton_code(float x, float y, float z) {
+    auto quantize = [](float f) {
+        return static_cast<uint32_t>(std::clamp(f, 0.f, 1.f) * 1023.f);
+    };
+    return (spread_bits(quantize(x)) << 2) | (spread_bits(quantize(y)) << 1) |
+           spread_bits(quantize(z));
+}
+}  // namespace
+
+std::vector<int> MeshOptimization::tipsify(const std::vector<int>& indices,
+                                           int nverts,
+                                           int cache_size) {
+    int ntris{static_cast<int>(indices.size()) / 3};
+    if (ntris == 0)
+        return {};
+
+    // build the vertex -> triangle adjacency in compressed form. live[v] is
+    // the number of triangles using v that still need to be emitted.
+    std::vector<int> live(nverts, 0);
+    for (int i : indices)
+        live[i]++;
+
+    std::vector<int> offsets(nverts + 1, 0);
+    for (int v = 0; v < nverts; v++)
+        offsets[v + 1] = offsets[v] + live[v];
+
+    std::vector<int> adjacency(indices.size());
+    std::vector<int> fill{offsets.begin(), offsets.end() - 1};
+    for (int i = 0; i < static_cast<int>(indices.size()); i++)
+        adjacency[fill[indices[i]]++] = i / 3;
+
+    std::vector<int> cache_time(nverts, 0);
+    std::vector<bool> emitted(ntris, false);
+    std::vector<int> dead_end{};
+    std::vector<int> candidates{};
+    std::vector<int> output{};
+    output.reserve(indices.size());
+
+    int fanning{0};            // vertex whose triangles are being emitted
+    int time{cache_size + 1};  // time stamp for the cache
+    int cursor{1};             // next vertex to try once we run out of ideas
+
+    while (fanning >= 0) {
+        candidates.clear();
+
+        // emit every remaining triangle around the fanning vertex
+        for (int a = offsets[fanning]; a < offsets[fanning + 1]; a++) {
+            int t{adjacency[a]};
+            if (emitted[t])
+                continue;
+
+            for (int k = 0; k < 3; k++) {
+                int v{indices[3 * t + k]};
+                output.push_back(v);
+                dead_end.push_back(v);
+                candidates.push_back(v);
+                live[v]--;
+                if (time - cache_time[v] > cache_size)  // not in cache
+                    cache_time[v] = time++;
+            }
+            emitted[t] = true;
+        }
+
+        // pick the candidate that will stay in the cache the longest while
+        // its remaining triangles are emitted
+        int next{-1};
+        int best{-1};
+        for (int v : candidates) {
+            if (live[v] <= 0)
+                continue;
+            int priority{0};
+            if (time - cache_time[v] + 2 * live[v] <= cache_size)
+                priority = time - cache_time[v];
+            if (priority > best) {
+                best = priority;
+                next = v;
+            }
+        }
+
+        // no candidates are left, fall back to a recently used vertex and
+        // then to the next vertex in the input order
+        while (next == -1 && !dead_end.empty()) {
+            int v{dead_end.back()};
+            dead_end.pop_back();
+            if (live[v] > 0)
+                next = v;
+        }
+        while (next == -1 && cursor < nverts) {
+            if (live[cursor] > 0)
+                next = cursor;
+            cursor++;
+        }
+
+        fanning = next;
+    }
+
+    return output;
+}
+
+std::vector<int> MeshOptimization::spatial_order(
+    const std::vector<int>& indices,
+    const std::vector<Vector<4>>& positions) {
+    int ntris{static_cast<int>(indices.size()) / 3};
+    int nclusters{(ntris + CLUSTER_SIZE - 1) / CLUSTER_SIZE};
+
+    // bounding box of the whole mesh
+    Vector<3> lo{std::numeric_limits<float>::max(),
+                 std::numeric_limits<float>::max(),
+                 std::numeric_limits<float>::max()};
+    Vector<3> hi{-std::numeric_limits<float>::max(),
+                 -std::numeric_limits<float>::max(),
+                 -std::numeric_limits<float>::max()};
+    for (int i : indices) {
+        for (int c = 0; c < 3; c++) {
+            lo[c] = std::min(lo[c], positions[i][c]);
+            hi[c] = std::max(hi[c], positions[i][c]);
+        }
+    }
+
+    Vector<3> extent{hi - lo};
+    for (int c = 0; c < 3; c++)
+        extent[c] = extent[c] > 0 ? extent[c] : 1.f;
+
+    // key each cluster by the Morton code of its centroid
+    std::vector<uint32_t> keys(nclusters);
+    for (int cluster = 0; cluster < nclusters; cluster++) {
+        int first{cluster * CLUSTER_SIZE * 3};
+        int last{std::min(first + CLUSTER_SIZE * 3,
+                          static_cast<int>(indices.size()))};
+
+        Vector<3> centroid{};
+        for (int i = first; i < last; i++) {
+            for (int c = 0; c < 3; c++)
+                centroid[c] += positions[indices[i]][c];
+        }
+        centroid = 1.f / static_cast<float>(last - first) * centroid;
+
+        keys[cluster] = morton_code((centroid[X] - lo[X]) / extent[X],
+                                    (centroid[Y] - lo[Y]) / extent[Y],
+                                    (centroid[Z] - lo[Z]) / extent[Z]);
+    }
+
+    std::vector<int> order(nclusters);
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(),
+                     [&keys](int a, int b) { return keys[a] < keys[b]; });
+
+    std::vector<int> output{};
+    output.reserve(indices.size());
+    for (int cluster : order) {
+        int first{cluster * CLUSTER_SIZE * 3};
+        int last{std::min(first + CLUSTER_SIZE * 3,
+                          static_cast<int>(indices.size()))};
+        output.insert(output.end(), indices.begin() + first,
+                      indices.begin() + last);
+    }
+    return output;
+}
+
+std::vector<int> MeshOptimization::fetch_order(std::vector<int>& indices,
+                                               int nverts) {
+    std::vector<int> remap(nverts, -1);
+    std::vector<int> old_index{};
+    old_index.reserve(nverts);
+
+    for (int& i : indices) {
+        if (remap[i] == -1) {
+            remap[i] = static_cast<int>(old_index.size());
+            old_index.push_back(i);
+        }
+        i = remap[i];
+    }
+    return old_index;
+}
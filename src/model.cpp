@@ -1,13 +1,55 @@
 #include "model.h"
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <charconv>
+#include <cmath>
 #include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <limits>
 #include <fstream>
 #include <iostream>
 #include <string>
 #include <string_view>
+#include <unordered_map>
+#include <utility>
 #include <vector>
+#include "mesh_optimizer.h"
+#include "parallel.h"
 
-Model::Model(std::string filename) : verticies{}, faces{}, normals{} {
+// magic number at the start of optimized mesh cache files
+constexpr char CACHE_MAGIC[8] = {'O', 'B', 'J', 'O', 'P', 'T', '0', '2'};
+
+// number of lines parsed between progress reports
+constexpr int PROGRESS_INTERVAL = 4096;
+
+// revisions are handed out from one counter so no two models share one
+static uint64_t next_revision() {
+    static std::atomic<uint64_t> revisions{0};
+    return ++revisions;
+}
+
+Model::Model(std::string filename,
+             const ModelOptions& options,
+             const std::function<void(float)>& progress)
+    : verticies{}, faces{}, normals{} {
+    std::string cache{filename + ".opt"};
+    if (!options.optimize || !load_cache(filename, cache, options))
+        load_obj(filename, options, progress);
+
+    if (options.compact)
+        compress(options.normal_bits);
+
+    build_clusters();
+    revision_ = next_revision();
+}
+
+void Model::load_obj(const std::string& filename,
+                     const ModelOptions& options,
+                     const std::function<void(float)>& progress) {
     std::ifstream inf{filename};
 
     if (!inf) {
@@ -15,11 +57,20 @@ Model::Model(std::string filename) : verticies{}, faces{}, normals{} {
         return;
     }
 
+    std::error_code ec{};
+    float file_size{
+        static_cast<float>(std::filesystem::file_size(filename, ec))};
+    int lines{0};
+
     for (std::string line{}; std::getline(inf, line);) {
+        if (progress && !ec && ++lines % PROGRESS_INTERVAL == 0)
+            progress(static_cast<float>(inf.tellg()) / file_size);
+
         if (line.length() == 0)
             continue;
 
-        std::string_view entry_type{line.substr(0, line.find(' '))};
+        std::string_view entry_type{
+            std::string_view{line}.substr(0, line.find(' '))};
         if (entry_type == "v")
             verticies.push_back(ModelParsing::parse_vector(line));
         if (entry_type == "f")
@@ -29,6 +80,22 @@ Model::Model(std::string filename) : verticies{}, faces{}, normals{} {
     }
 
     // normalize the point coordinate values into the range of [-1, 1]
+
+    // fill in the normals of the corners that are missing them
+    bool missing_normals{false};
+    for (const std::vector<FaceTuple>& face : faces) {
+        for (const FaceTuple& tuple : face) {
+            missing_normals |= tuple.normal < 0 ||
+                               tuple.normal >= static_cast<int>(normals.size());
+        }
+    }
+    if (missing_normals)
+        generate_normals(options.crease_angle);
+
+    if (options.optimize) {
+        optimize();
+        save_cache(filename + ".opt", options);
+    }
 }
 
 int Model::nfaces() const {
@@ -36,38 +103,534 @@ int Model::nfaces() const {
 }
 
 Vector<4> Model::vertex(int i) const {
-    return verticies[i];
+    if (!compact_)
+        return verticies[i];
+
+    const std::array<uint16_t, 3>& q{packed_verticies[i]};
+    return {position_origin[X] + position_scale[X] * q[X],
+            position_origin[Y] + position_scale[Y] * q[Y],
+            position_origin[Z] + position_scale[Z] * q[Z], 1.f};
 }
 
 Vector<4> Model::normal(int i) const {
-    return normals[i];
+    if (!compact_)
+        return normals[i];
+
+    if (normal_bits_ == 8) {
+        uint16_t packed{packed_normals8[i]};
+        return Compression::decode_octahedral(packed >> 8, packed & 0xff, 8);
+    }
+    uint32_t packed{packed_normals16[i]};
+    return Compression::decode_octahedral(packed >> 16, packed & 0xffff, 16);
+}
+
+bool Model::compact() const {
+    return compact_;
+}
+
+const std::vector<Cluster>& Model::clusters() const {
+    return clusters_;
+}
+
+uint64_t Model::revision() const {
+    return revision_;
+}
+
+void Model::build_clusters() {
+    clusters_.clear();
+    for (int first = 0; first < nfaces();
+         first += MeshOptimization::CLUSTER_SIZE) {
+        Cluster cluster{first,
+                        std::min(MeshOptimization::CLUSTER_SIZE,
+                                 nfaces() - first),
+                        {std::numeric_limits<float>::max(),
+                         std::numeric_limits<float>::max(),
+                         std::numeric_limits<float>::max()},
+                        {-std::numeric_limits<float>::max(),
+                         -std::numeric_limits<float>::max(),
+                         -std::numeric_limits<float>::max()}};
+
+        for (int f = first; f < first + cluster.nfaces; f++) {
+            for (const FaceTuple& tuple : faces[f]) {
+                Vector<3> p{vertex(tuple.vertex).dehomogenize()};
+                for (int c = 0; c < 3; c++) {
+                    cluster.lo[c] = std::min(cluster.lo[c], p[c]);
+                    cluster.hi[c] = std::max(cluster.hi[c], p[c]);
+                }
+            }
+        }
+        clusters_.push_back(cluster);
+    }
 }
 
-std::vector<FaceTuple> Model::face(int i) const {
+// quantize the positions to 16 bits per axis inside the bounding box of the
+// model and store the normals octahedral encoded
+void Model::compress(int normal_bits) {
+    if (normal_bits != 8 && normal_bits != 16)
+        throw "normals can only be stored in 8 or 16 bits per component";
+
+    Vector<3> lo{std::numeric_limits<float>::max(),
+                 std::numeric_limits<float>::max(),
+                 std::numeric_limits<float>::max()};
+    Vector<3> hi{-std::numeric_limits<float>::max(),
+                 -std::numeric_limits<float>::max(),
+                 -std::numeric_limits<float>::max()};
+    for (const Vector<4>& v : verticies) {
+        Vector<3> p{v.dehomogenize()};
+        for (int c = 0; c < 3; c++) {
+            lo[c] = std::min(lo[c], p[c]);
+            hi[c] = std::max(hi[c], p[c]);
+        }
+    }
+
+    constexpr float steps{std::numeric_limits<uint16_t>::max()};
+    for (int c = 0; c < 3; c++) {
+        position_origin[c] = lo[c];
+        position_scale[c] = hi[c] > lo[c] ? (hi[c] - lo[c]) / steps : 0.f;
+    }
+
+    packed_verticies.resize(verticies.size());
+    parallel_for(static_cast<int>(verticies.size()), [&](int i) {
+        Vector<3> p{verticies[i].dehomogenize()};
+        for (int c = 0; c < 3; c++) {
+            float q{position_scale[c] > 0
+                        ? (p[c] - position_origin[c]) / position_scale[c]
+                        : 0.f};
+            packed_verticies[i][c] =
+                static_cast<uint16_t>(std::clamp(std::round(q), 0.f, steps));
+        }
+    });
+
+    if (normal_bits == 8)
+        packed_normals8.resize(normals.size());
+    else
+        packed_normals16.resize(normals.size());
+    parallel_for(static_cast<int>(normals.size()), [&](int i) {
+        Vector<4> n{normals[i]};
+        auto [u, v] = Compression::encode_octahedral(
+            {n[X], n[Y], n[Z]}, normal_bits);
+        if (normal_bits == 8)
+            packed_normals8[i] = static_cast<uint16_t>(u << 8 | v);
+        else
+            packed_normals16[i] = u << 16 | v;
+    });
+
+    verticies.clear();
+    verticies.shrink_to_fit();
+    normals.clear();
+    normals.shrink_to_fit();
+    normal_bits_ = normal_bits;
+    compact_ = true;
+}
+
+const std::vector<FaceTuple>& Model::face(int i) const {
     return faces[i];
 }
 
+ModelMemory Model::memory_usage() const {
+    ModelMemory memory{};
+    memory.positions =
+        verticies.capacity() * sizeof(Vector<4>) +
+        packed_verticies.capacity() * sizeof(std::array<uint16_t, 3>);
+    memory.normals = normals.capacity() * sizeof(Vector<4>) +
+                     packed_normals8.capacity() * sizeof(uint16_t) +
+                     packed_normals16.capacity() * sizeof(uint32_t);
+    memory.faces = faces.capacity() * sizeof(std::vector<FaceTuple>);
+    for (const std::vector<FaceTuple>& face : faces)
+        memory.faces += face.capacity() * sizeof(FaceTuple);
+    memory.clusters = clusters_.capacity() * sizeof(Cluster);
+    return memory;
+}
+
+std::size_t ModelMemory::total() const {
+    return positions + normals + faces + clusters;
+}
+
+void Model::optimize() {
+    if (compact_)
+        throw "compact models can not be optimized";
+
+    // give every distinct (position, normal) pair a single shared index and
+    // fan the polygons into triangles on the way
+    std::unordered_map<uint64_t, int> merged{};
+    std::vector<Vector<4>> merged_verticies{};
+    std::vector<Vector<4>> merged_normals{};
+    std::vector<int> indices{};
+
+    auto merge = [&](const FaceTuple& tuple) {
+        uint64_t key{static_cast<uint64_t>(static_cast<uint32_t>(tuple.vertex))
+                         << 32 |
+                     static_cast<uint32_t>(tuple.normal)};
+        auto [it, inserted] = merged.try_emplace(
+            key, static_cast<int>(merged_verticies.size()));
+        if (inserted) {
+            merged_verticies.push_back(verticies[tuple.vertex]);
+            bool has_normal{tuple.normal >= 0 &&
+                            tuple.normal < static_cast<int>(normals.size())};
+            merged_normals.push_back(has_normal ? normals[tuple.normal]
+                                                : Vector<4>{});
+        }
+        return it->second;
+    };
+
+    for (const std::vector<FaceTuple>& face : faces) {
+        int first{merge(face[0])};
+        for (int j = 2; j < static_cast<int>(face.size()); j++) {
+            indices.push_back(first);
+            indices.push_back(merge(face[j - 1]));
+            indices.push_back(merge(face[j]));
+        }
+    }
+
+    int nverts{static_cast<int>(merged_verticies.size())};
+    indices = MeshOptimization::tipsify(indices, nverts,
+                                        MeshOptimization::VERTEX_CACHE_SIZE);
+    indices = MeshOptimization::spatial_order(indices, merged_verticies);
+    std::vector<int> old_index{MeshOptimization::fetch_order(indices, nverts)};
+
+    verticies.clear();
+    normals.clear();
+    for (int i : old_index) {
+        verticies.push_back(merged_verticies[i]);
+        normals.push_back(merged_normals[i]);
+    }
+
+    faces.clear();
+    for (int i = 0; i < static_cast<int>(indices.size()); i += 3) {
+        faces.push_back({{indices[i], -1, indices[i]},
+                         {indices[i + 1], -1, indices[i + 1]},
+                         {indices[i + 2], -1, indices[i + 2]}});
+    }
+    build_clusters();
+    revision_ = next_revision();
+}
+
+// Normals are generated without any scattered writes so that every step can
+// run in parallel: each face computes the weighted normals of its own
+// corners, then each vertex gathers the corners around it through a
+// vertex -> corner adjacency list.
+void Model::generate_normals(float crease_angle) {
+    if (compact_)
+        throw "compact models can not generate normals";
+
+    int nverts{static_cast<int>(verticies.size())};
+    int nfaces{static_cast<int>(faces.size())};
+
+    // corners of face f are numbered first_corner[f] .. first_corner[f + 1]
+    std::vector<int> first_corner(nfaces + 1, 0);
+    for (int f = 0; f < nfaces; f++)
+        first_corner[f + 1] = first_corner[f] + faces[f].size();
+    int ncorners{first_corner[nfaces]};
+
+    std::vector<int> corner_face(ncorners);
+    for (int f = 0; f < nfaces; f++)
+        std::fill(corner_face.begin() + first_corner[f],
+                  corner_face.begin() + first_corner[f + 1], f);
+
+    // corners with a normal from the file keep it, the generated normals
+    // are added after the authored ones
+    int authored{static_cast<int>(normals.size())};
+    auto missing = [&](const FaceTuple& tuple) {
+        return tuple.normal < 0 || tuple.normal >= authored;
+    };
+
+    auto position = [this](int v) {
+        const Vector<4>& p{verticies[v]};
+        return Vector<3>{p[X], p[Y], p[Z]};
+    };
+
+    // unit face normals and the corner normals weighted by the area of the
+    // face and the angle of the face at that corner
+    std::vector<Vector<3>> face_normals(nfaces);
+    std::vector<Vector<3>> corner_normals(ncorners);
+    parallel_for(nfaces, [&](int f) {
+        const std::vector<FaceTuple>& face{faces[f]};
+        int n{static_cast<int>(face.size())};
+
+        // Newell's method, the length of the sum is twice the face's area
+        Vector<3> normal{};
+        for (int j = 0; j < n; j++) {
+            Vector<3> a{position(face[j].vertex)};
+            Vector<3> b{position(face[(j + 1) % n].vertex)};
+            normal[X] += (a[Y] - b[Y]) * (a[Z] + b[Z]);
+            normal[Y] += (a[Z] - b[Z]) * (a[X] + b[X]);
+            normal[Z] += (a[X] - b[X]) * (a[Y] + b[Y]);
+        }
+        face_normals[f] = normal.normalize();
+
+        for (int j = 0; j < n; j++) {
+            Vector<3> p{position(face[j].vertex)};
+            Vector<3> prev{(position(face[(j + n - 1) % n].vertex) - p)};
+            Vector<3> next{(position(face[(j + 1) % n].vertex) - p)};
+            float cos_angle{
+                dot_product(prev.normalize(), next.normalize())};
+            float angle{std::acos(std::clamp(cos_angle, -1.f, 1.f))};
+            corner_normals[first_corner[f] + j] = (0.5f * angle) * normal;
+        }
+    });
+
+    // vertex -> corner adjacency (corners around v are
+    // adjacency[offsets[v]] .. adjacency[offsets[v + 1]])
+    std::vector<int> offsets(nverts + 1, 0);
+    for (const std::vector<FaceTuple>& face : faces) {
+        for (const FaceTuple& tuple : face)
+            offsets[tuple.vertex + 1]++;
+    }
+    for (int v = 0; v < nverts; v++)
+        offsets[v + 1] += offsets[v];
+
+    std::vector<int> adjacency(ncorners);
+    std::vector<int> fill{offsets.begin(), offsets.end() - 1};
+    for (int f = 0; f < nfaces; f++) {
+        for (int j = 0; j < static_cast<int>(faces[f].size()); j++)
+            adjacency[fill[faces[f][j].vertex]++] = first_corner[f] + j;
+    }
+
+    // without creases every corner of a vertex shares one normal
+    if (crease_angle >= std::numbers::pi_v<float>) {
+        normals.resize(authored + nverts);
+        parallel_for(nverts, [&](int v) {
+            Vector<3> sum{};
+            for (int a = offsets[v]; a < offsets[v + 1]; a++)
+                sum = sum + corner_normals[adjacency[a]];
+            normals[authored + v] = sum.normalize().homogenize();
+        });
+        parallel_for(nfaces, [&](int f) {
+            for (FaceTuple& tuple : faces[f]) {
+                if (missing(tuple))
+                    tuple.normal = authored + tuple.vertex;
+            }
+        });
+        return;
+    }
+
+    // otherwise each corner only averages the faces around the vertex that
+    // are within the crease angle of its own face. Corners of a vertex that
+    // end up with the same normal share it.
+    float cos_crease{std::cos(crease_angle)};
+    std::vector<Vector<4>> smoothed(ncorners);
+    std::vector<int> shared(ncorners);
+    parallel_for(nverts, [&](int v) {
+        for (int a = offsets[v]; a < offsets[v + 1]; a++) {
+            int corner{adjacency[a]};
+            const Vector<3>& face_normal{face_normals[corner_face[corner]]};
+
+            Vector<3> sum{};
+            for (int b = offsets[v]; b < offsets[v + 1]; b++) {
+                int other{adjacency[b]};
+                if (dot_product(face_normal,
+                                face_normals[corner_face[other]]) >=
+                    cos_crease)
+                    sum = sum + corner_normals[other];
+            }
+            smoothed[corner] = sum.normalize().homogenize();
+
+            shared[corner] = corner;
+            for (int b = offsets[v]; b < a; b++) {
+                int other{adjacency[b]};
+                const Vector<4>& n1{smoothed[corner]};
+                const Vector<4>& n2{smoothed[other]};
+                if (n1[X] == n2[X] && n1[Y] == n2[Y] && n1[Z] == n2[Z]) {
+                    shared[corner] = shared[other];
+                    break;
+                }
+            }
+        }
+    });
+
+    // only the normals some corner without one of its own uses are kept
+    std::vector<int> remap(ncorners, -1);
+    for (int corner = 0; corner < ncorners; corner++) {
+        int f{corner_face[corner]};
+        int source{shared[corner]};
+        if (missing(faces[f][corner - first_corner[f]]) &&
+            remap[source] < 0) {
+            remap[source] = static_cast<int>(normals.size());
+            normals.push_back(smoothed[source]);
+        }
+    }
+    parallel_for(nfaces, [&](int f) {
+        for (int j = 0; j < static_cast<int>(faces[f].size()); j++) {
+            if (missing(faces[f][j]))
+                faces[f][j].normal = remap[shared[first_corner[f] + j]];
+        }
+    });
+    revision_ = next_revision();
+}
+
+// try to read the optimized mesh from the cache file. The cache is only used
+// if it is at least as new as the .obj file it was made from and was made
+// with the same options.
+bool Model::load_cache(const std::string& filename,
+                       const std::string& cache,
+                       const ModelOptions& options) {
+    std::error_code ec{};
+    auto obj_time{std::filesystem::last_write_time(filename, ec)};
+    if (ec)
+        return false;
+    auto cache_time{std::filesystem::last_write_time(cache, ec)};
+    if (ec || cache_time < obj_time)
+        return false;
+
+    std::ifstream inf{cache, std::ios::binary};
+    char magic[sizeof(CACHE_MAGIC)]{};
+    inf.read(magic, sizeof(magic));
+    if (!inf || std::memcmp(magic, CACHE_MAGIC, sizeof(magic)) != 0)
+        return false;
+
+    auto read_int = [&inf]() {
+        int32_t i{};
+        inf.read(reinterpret_cast<char*>(&i), sizeof(i));
+        return i;
+    };
+    float crease_angle{};
+    inf.read(reinterpret_cast<char*>(&crease_angle), sizeof(crease_angle));
+    if (!inf || crease_angle != options.crease_angle)
+        return false;
+
+    auto read_vector = [&inf]() {
+        Vector<4> v{};
+        for (int c = 0; c < 4; c++)
+            inf.read(reinterpret_cast<char*>(&v[c]), sizeof(float));
+        return v;
+    };
+
+    int nverts{read_int()};
+    for (int i = 0; inf && i < nverts; i++) {
+        verticies.push_back(read_vector());
+        normals.push_back(read_vector());
+    }
+
+    // a corrupt index would only show up as an out of bounds read when
+    // drawing, so every one of them is checked here
+    bool valid{nverts >= 0};
+    auto in_range = [nverts](int index) {
+        return index >= 0 && index < nverts;
+    };
+
+    int ntris{read_int()};
+    for (int i = 0; inf && valid && i < ntris; i++) {
+        int a{read_int()};
+        int b{read_int()};
+        int c{read_int()};
+        valid = in_range(a) && in_range(b) && in_range(c);
+        faces.push_back({{a, -1, a}, {b, -1, b}, {c, -1, c}});
+    }
+
+    // truncated or corrupt cache, parse the .obj file instead
+    if (!inf || !valid || ntris < 0) {
+        verticies.clear();
+        normals.clear();
+        faces.clear();
+        return false;
+    }
+    return true;
+}
+
+void Model::save_cache(const std::string& cache,
+                       const ModelOptions& options) const {
+    std::ofstream outf{cache, std::ios::binary};
+    if (!outf) {
+        std::cerr << "Could not write mesh cache.\n";
+        return;
+    }
+
+    auto write_int = [&outf](int32_t i) {
+        outf.write(reinterpret_cast<const char*>(&i), sizeof(i));
+    };
+    auto write_vector = [&outf](const Vector<4>& v) {
+        for (int c = 0; c < 4; c++)
+            outf.write(reinterpret_cast<const char*>(&v[c]), sizeof(float));
+    };
+
+    outf.write(CACHE_MAGIC, sizeof(CACHE_MAGIC));
+    outf.write(reinterpret_cast<const char*>(&options.crease_angle),
+               sizeof(options.crease_angle));
+    write_int(static_cast<int32_t>(verticies.size()));
+    for (int i = 0; i < static_cast<int>(verticies.size()); i++) {
+        write_vector(verticies[i]);
+        write_vector(normals[i]);
+    }
+
+    write_int(static_cast<int32_t>(faces.size()));
+    for (const std::vector<FaceTuple>& face : faces) {
+        for (const FaceTuple& tuple : face)
+            write_int(tuple.vertex);
+    }
+}
+
+std::pair<uint32_t, uint32_t> Compression::encode_octahedral(
+    const Vector<3>& n,
+    int bits) {
+    // project onto the octahedron |x| + |y| + |z| = 1 and fold the lower
+    // half over the upper one
+    float length{std::abs(n[X]) + std::abs(n[Y]) + std::abs(n[Z])};
+    float x{length > 0 ? n[X] / length : 0.f};
+    float y{length > 0 ? n[Y] / length : 0.f};
+    if (n[Z] < 0) {
+        float folded_x{(1.f - std::abs(y)) * (x >= 0 ? 1.f : -1.f)};
+        float folded_y{(1.f - std::abs(x)) * (y >= 0 ? 1.f : -1.f)};
+        x = folded_x;
+        y = folded_y;
+    }
+
+    float steps{static_cast<float>((1u << bits) - 1)};
+    auto quantize = [steps](float f) {
+        return static_cast<uint32_t>(
+            std::clamp(std::round((f * 0.5f + 0.5f) * steps), 0.f, steps));
+    };
+    return {quantize(x), quantize(y)};
+}
+
+Vector<4> Compression::decode_octahedral(uint32_t u, uint32_t v, int bits) {
+    float steps{static_cast<float>((1u << bits) - 1)};
+    float x{static_cast<float>(u) / steps * 2.f - 1.f};
+    float y{static_cast<float>(v) / steps * 2.f - 1.f};
+    float z{1.f - std::abs(x) - std::abs(y)};
+
+    // unfold the lower half of the octahedron
+    float t{std::max(-z, 0.f)};
+    x += x >= 0 ? -t : t;
+    y += y >= 0 ? -t : t;
+
+    return Vector<3>{x, y, z}.normalize().homogenize();
+}
+
+// parse the number at the start of the word without copying it, anything
+// after the number (like the '\r' of windows line endings) is ignored
+template <typename T>
+static T parse_number(std::string_view word) {
+    T value{};
+    if (std::from_chars(word.data(), word.data() + word.size(), value).ec !=
+        std::errc{})
+        throw "malformed number";
+    return value;
+}
+
 // given a string of input get the vertex value
-Vector<4> ModelParsing::parse_vector(const std::string& line) {
+Vector<4> ModelParsing::parse_vector(std::string_view line) {
     // ignoring w entry for simplicity
-    std::vector<std::string> split_strs{ModelParsing::split_string(line)};
+    std::vector<std::string_view> split_strs{ModelParsing::split_string(line)};
+    if (split_strs.size() < 4)
+        throw "vectors must have at least 3 components";
 
     return {
-        std::stof(split_strs[1]),  // don't count 'v' char
-        std::stof(split_strs[2]), std::stof(split_strs[3]),
+        parse_number<float>(split_strs[1]),  // don't count 'v' char
+        parse_number<float>(split_strs[2]), parse_number<float>(split_strs[3]),
         split_strs.size() == 5
-            ? std::stof(split_strs[4])
+            ? parse_number<float>(split_strs[4])
             : 1.f  // vectors may optionally include the 'w' index for the
                    // vector otherwise if not provided default to 1.0
     };
 }
 
-std::vector<FaceTuple> ModelParsing::parse_face(const std::string& line) {
-    std::vector<std::string> face_tuple_strings = split_string(line);
+std::vector<FaceTuple> ModelParsing::parse_face(std::string_view line) {
+    std::vector<std::string_view> face_tuple_strings = split_string(line);
     std::vector<FaceTuple> faces{};
     if (face_tuple_strings.size() < 3) {
         throw "faces must have at least 3 verticies";
     }
+    faces.reserve(face_tuple_strings.size() - 1);
     for (int i = 1; i < face_tuple_strings.size(); i++) {
         faces.push_back(ModelParsing::parse_face_tuple(face_tuple_strings[i]));
     }
@@ -75,41 +638,41 @@ std::vector<FaceTuple> ModelParsing::parse_face(const std::string& line) {
 }
 
 // rename these variables they aren't great
-FaceTuple ModelParsing::parse_face_tuple(const std::string& line) {
+FaceTuple ModelParsing::parse_face_tuple(std::string_view line) {
     unsigned long start{0};
     unsigned long stop{line.find('/')};
     int vertex_index{0};
 
     if (stop == -1) {
-        vertex_index = std::stoi(line.substr(start, line.length())) - 1;
+        vertex_index = parse_number<int>(line.substr(start)) - 1;
         return {vertex_index};
     } else {
-        vertex_index = std::stoi(line.substr(start, stop - start)) - 1;
+        vertex_index = parse_number<int>(line.substr(start, stop - start)) - 1;
     }
 
     start = stop + 1;
     stop = line.find('/', start);
     int vertex_texture_index{0};
     if (stop == -1) {
-        vertex_texture_index = std::stoi(line.substr(start, line.length())) - 1;
+        vertex_texture_index = parse_number<int>(line.substr(start)) - 1;
         return {vertex_index, vertex_texture_index};
     } else {
         if (stop - start == 0)  // in case of no second argument i.e. u//w
-            vertex_texture_index = 0;
+            vertex_texture_index = -1;
         else
             vertex_texture_index =
-                std::stoi(line.substr(start, stop - start)) - 1;
+                parse_number<int>(line.substr(start, stop - start)) - 1;
     }
 
     int vertex_normal_index{0};
     start = stop + 1;
-    vertex_normal_index = std::stoi(line.substr(start, line.length())) - 1;
+    vertex_normal_index = parse_number<int>(line.substr(start)) - 1;
     return {vertex_index, vertex_texture_index, vertex_normal_index};
 }
 
 // splits string at space characters
-std::vector<std::string> ModelParsing::split_string(const std::string& str) {
-    std::vector<std::string> strings{};
+std::vector<std::string_view> ModelParsing::split_string(std::string_view str) {
+    std::vector<std::string_view> strings{};
     int start_idx{0};
     int len{0};
     bool in_string{false};
@@ -0,0 +1,91 @@
+#include "model_cache.h"
+
+#include <cstddef>
+#include <filesystem>
+#include <iterator>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include "model.h"
+#include "model_loader.h"
+
+ModelCache::ModelCache(std::size_t max_bytes,
+                       ModelOptions options,
+                       int nthreads)
+    : max_bytes_{max_bytes}, options_{options}, loader_{nthreads} {}
+
+std::shared_ptr<const Model> ModelCache::get(const std::string& filename) {
+    std::error_code ec{};
+    std::filesystem::file_time_type mtime{
+        std::filesystem::last_write_time(filename, ec)};
+    if (ec)
+        throw std::runtime_error("could not open model " + filename);
+
+    ModelLoad load{};
+    {
+        std::lock_guard lock{mutex_};
+        auto found = index_.find(filename);
+        if (found != index_.end() && found->second->mtime == mtime) {
+            entries_.splice(entries_.begin(), entries_, found->second);
+        } else {
+            // the file changed (or was never loaded)
+            if (found != index_.end()) {
+                bytes_ -= found->second->bytes;
+                entries_.erase(found->second);
+            }
+            entries_.push_front(
+                {filename, mtime, loader_.load(filename, options_), 0});
+            index_[filename] = entries_.begin();
+        }
+        load = entries_.front().load;
+    }
+
+    std::shared_ptr<const Model> model{};
+    try {
+        model = load.get();
+    } catch (...) {
+        // forget the failed load so that the next request tries again
+        std::lock_guard lock{mutex_};
+        auto found = index_.find(filename);
+        if (found != index_.end() && found->second->mtime == mtime &&
+            found->second->bytes == 0) {
+            entries_.erase(found->second);
+            index_.erase(found);
+        }
+        throw;
+    }
+
+    std::lock_guard lock{mutex_};
+    auto found = index_.find(filename);
+    if (found != index_.end() && found->second->mtime == mtime &&
+        found->second->bytes == 0) {
+        found->second->bytes = model->memory_usage().total();
+        bytes_ += found->second->bytes;
+        evict();
+    }
+    return model;
+}
+
+// drop the least recently used models until the rest fit the budget. The
+// most recently used model is always kept, even if it alone is too big.
+void ModelCache::evict() {
+    while (bytes_ > max_bytes_ && entries_.size() > 1) {
+        auto last = std::prev(entries_.end());
+        bytes_ -= last->bytes;
+        index_.erase(last->filename);
+        entries_.erase(last);
+    }
+}
+
+int ModelCache::size() const {
+    std::lock_guard lock{mutex_};
+    return static_cast<int>(entries_.size());
+}
+
+std::size_t ModelCache::bytes() const {
+    std::lock_guard lock{mutex_};
+    return bytes_;
+}
@@ -0,0 +1,124 @@
+#include "model_loader.h"
+
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <functional>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include "model.h"
+
+//=============================================================================
+// Model Load Handle
+//=============================================================================
+float ModelLoad::progress() const {
+    return progress_->load(std::memory_order_relaxed);
+}
+
+bool ModelLoad::ready() const {
+    return model_.wait_for(std::chrono::seconds(0)) ==
+           std::future_status::ready;
+}
+
+std::shared_ptr<const Model> ModelLoad::get() const {
+    return model_.get();
+}
+
+//=============================================================================
+// Model Loader
+//=============================================================================
+ModelLoader::ModelLoader(int nthreads) {
+    for (int i = 0; i < nthreads; i++)
+        workers_.emplace_back(&ModelLoader::work, this);
+}
+
+ModelLoader::~ModelLoader() {
+    {
+        std::lock_guard lock{mutex_};
+        stopping_ = true;
+    }
+    cv_.notify_all();
+    for (std::thread& worker : workers_)
+        worker.join();
+}
+
+ModelLoad ModelLoader::load(std::string filename, ModelOptions options) {
+    ModelLoad load{};
+    load.progress_ = std::make_shared<std::atomic<float>>(0.f);
+
+    // std::function needs a copyable callable so the task is shared
+    using Task = std::packaged_task<std::shared_ptr<const Model>()>;
+    auto task = std::make_shared<Task>(
+        [filename, options, progress = load.progress_]() {
+            auto model = std::make_shared<const Model>(
+                filename, options, [&progress](float fraction) {
+                    progress->store(fraction, std::memory_order_relaxed);
+                });
+            progress->store(1.f, std::memory_order_relaxed);
+            return model;
+        });
+    load.model_ = task->get_future().share();
+
+    {
+        std::lock_guard lock{mutex_};
+        jobs_.push([task]() { (*task)(); });
+    }
+    cv_.notify_one();
+    return load;
+}
+
+void ModelLoader::work() {
+    for (;;) {
+        std::function<void()> job{};
+        {
+            std::unique_lock lock{mutex_};
+            cv_.wait(lock, [this]() { return stopping_ || !jobs_.empty(); });
+            if (stopping_ && jobs_.empty())
+                return;
+            job = std::move(jobs_.front());
+            jobs_.pop();
+        }
+        job();
+    }
+}
+
+//=============================================================================
+// Model Slot
+//=============================================================================
+std::shared_ptr<const Model> ModelSlot::current() const {
+    return current_.load();
+}
+
+void ModelSlot::request(ModelLoad load) {
+    pending_ = std::move(load);
+}
+
+bool ModelSlot::poll() {
+    if (!pending_ || !pending_->ready())
+        return false;
+
+    std::shared_ptr<const Model> model{};
+    try {
+        model = pending_->get();
+    } catch (const char* ex) {  // keep drawing the old model
+        std::cerr << ex << "\n";
+    } catch (const std::exception& ex) {
+        std::cerr << ex.what() << "\n";
+    } catch (...) {
+        std::cerr << "could not load model\n";
+    }
+    pending_.reset();
+
+    if (!model)
+        return false;
+    current_.store(std::move(model));
+    return true;
+}
+
+const std::optional<ModelLoad>& ModelSlot::pending() const {
+    return pending_;
+}
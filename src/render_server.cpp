@@ -0,0 +1,182 @@
+#include "render_server.h"
+
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <numbers>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include "model.h"
+#include "model_cache.h"
+#include "renderer.h"
+#include "shader.h"
+
+//=============================================================================
+// Render Server
+//=============================================================================
+RenderServer::RenderServer(ModelCache& cache, int nworkers) : cache_{cache} {
+    for (int i = 0; i < nworkers; i++)
+        workers_.emplace_back(&RenderServer::work, this);
+}
+
+RenderServer::~RenderServer() {
+    {
+        std::lock_guard lock{mutex_};
+        stopping_ = true;
+    }
+    cv_.notify_all();
+    for (std::thread& worker : workers_)
+        worker.join();
+}
+
+void RenderServer::submit(const std::string& line, Reply reply) {
+    auto submitted = std::chrono::steady_clock::now();
+    RenderRequest request{};
+    try {
+        request = RenderRequests::parse(line);
+    } catch (const std::exception& ex) {
+        reply(std::string{"error - "} + ex.what());
+        return;
+    }
+
+    {
+        std::lock_guard lock{mutex_};
+        jobs_.push({std::move(request), std::move(reply), submitted});
+    }
+    cv_.notify_one();
+}
+
+void RenderServer::work() {
+    // every worker draws with its own renderer, only the models are shared
+    std::unique_ptr<Renderer> renderer{Renderer::CreateHeadlessRenderer()};
+
+    for (;;) {
+        std::optional<Job> job{};
+        {
+            std::unique_lock lock{mutex_};
+            cv_.wait(lock, [this]() { return stopping_ || !jobs_.empty(); });
+            if (stopping_ && jobs_.empty())
+                return;
+            job = std::move(jobs_.front());
+            jobs_.pop();
+        }
+
+        std::string reply{};
+        try {
+            reply = render(*renderer, *job);
+        } catch (const std::exception& ex) {
+            reply = "error " + job->request.id + " " + ex.what();
+        } catch (const char* ex) {
+            reply = "error " + job->request.id + " " + ex;
+        }
+        job->reply(reply);
+    }
+}
+
+std::string RenderServer::render(Renderer& renderer, const Job& job) {
+    const RenderRequest& request{job.request};
+    std::shared_ptr<const Model> model{cache_.get(request.model)};
+
+    float radians{std::numbers::pi_v<float> / 180.f};
+    renderer.set_output_size(request.width, request.height);
+    renderer.yaw = request.yaw * radians;
+    renderer.pitch = request.pitch * radians;
+    renderer.light_dir = request.light_dir.normalize();
+    // shadow_light points away from the light, light_dir towards it
+    renderer.shadow_light = -1.f * request.light_dir;
+    renderer.pos = request.camera;
+
+    auto start = std::chrono::steady_clock::now();
+    renderer.clear_screen();
+    renderer.draw_model(*model, request.shading);
+    auto stop = std::chrono::steady_clock::now();
+
+    RenderRequests::write_ppm(request.output, renderer.framebuffer(),
+                              renderer.output_width(),
+                              renderer.output_height());
+
+    std::chrono::duration<float, std::milli> draw_time{stop - start};
+    std::chrono::duration<float, std::milli> total_time{
+        std::chrono::steady_clock::now() - job.submitted};
+    std::ostringstream reply{};
+    reply << "ok " << request.id << " " << draw_time.count() << " "
+          << total_time.count();
+    return reply.str();
+}
+
+//=============================================================================
+// Requests
+//=============================================================================
+RenderRequest RenderRequests::parse(const std::string& line) {
+    std::istringstream words{line};
+    std::string command{};
+    if (!(words >> command) || command != "render")
+        throw std::runtime_error("unknown request");
+
+    RenderRequest request{};
+    for (std::string key{}; words >> key;) {
+        if (key == "id") {
+            words >> request.id;
+        } else if (key == "model") {
+            words >> request.model;
+        } else if (key == "output") {
+            words >> request.output;
+        } else if (key == "resolution") {
+            words >> request.width >> request.height;
+        } else if (key == "shading") {
+            std::string name{};
+            words >> name;
+            std::optional<ShadingMode> mode{parse_shading_mode(name)};
+            if (!mode)
+                throw std::runtime_error("unknown shading mode " + name);
+            request.shading = *mode;
+        } else if (key == "yaw") {
+            words >> request.yaw;
+        } else if (key == "pitch") {
+            words >> request.pitch;
+        } else if (key == "light") {
+            words >> request.light_dir[X] >> request.light_dir[Y] >>
+                request.light_dir[Z];
+        } else if (key == "camera") {
+            words >> request.camera[X] >> request.camera[Y] >>
+                request.camera[Z];
+        } else {
+            throw std::runtime_error("unknown setting " + key);
+        }
+
+        if (words.fail())
+            throw std::runtime_error("missing or malformed value for " + key);
+    }
+
+    if (request.model.empty() || request.output.empty())
+        throw std::runtime_error("requests need a model and an output");
+    if (request.width <= 0 || request.height <= 0)
+        throw std::runtime_error("invalid resolution");
+    return request;
+}
+
+void RenderRequests::write_ppm(const std::string& filename,
+                               const PixelBuffer& pixels,
+                               int width,
+                               int height) {
+    std::ofstream outf{filename, std::ios::binary};
+    if (!outf)
+        throw std::runtime_error("could not write " + filename);
+
+    std::vector<char> rgb(pixels.size() * 3);
+    for (int i = 0; i < static_cast<int>(pixels.size()); i++) {
+        rgb[3 * i] = static_cast<char>(pixels[i] >> 16 & 0xff);
+        rgb[3 * i + 1] = static_cast<char>(pixels[i] >> 8 & 0xff);
+        rgb[3 * i + 2] = static_cast<char>(pixels[i] & 0xff);
+    }
+    outf << "P6\n" << width << " " << height << "\n255\n";
+    outf.write(rgb.data(), rgb.size());
+    if (!outf)
+        throw std::runtime_error("could not write " + filename);
+}
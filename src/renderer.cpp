@@ -6,7 +6,9 @@
 #include <functional>
 #include <limits>
 #include <memory>
+#include <utility>
 #include "model.h"
+#include "shadow_map.h"
 #include "vector.h"
 
 //=============================================================================
@@ -15,14 +17,27 @@
 
 Renderer* Renderer::renderer_ = nullptr;
 
-Renderer* Renderer::GetRenderer() {
+Renderer* Renderer::GetRenderer(bool headless) {
     if (renderer_ == nullptr) {
-        renderer_ = new Renderer();
+        renderer_ = new Renderer(headless);
     }
     return renderer_;
 }
 
-Renderer::Renderer() {
+std::unique_ptr<Renderer> Renderer::CreateHeadlessRenderer() {
+    return std::unique_ptr<Renderer>{new Renderer(true)};
+}
+
+std::unique_ptr<Renderer> Renderer::CreateDepthRenderer() {
+    return std::unique_ptr<Renderer>{new Renderer(true, true)};
+}
+
+Renderer::Renderer(bool headless, bool depth_only) : depth_only_{depth_only} {
+    set_output_size(SCREEN_WIDTH, SCREEN_HEIGHT);
+
+    if (headless)
+        return;
+
     if (SDL_Init(SDL_INIT_VIDEO) < 0) {
         fprintf(stderr, "could not initialize sdl2: %s\n", SDL_GetError());
         exit(-1);
@@ -38,45 +53,196 @@ Renderer::Renderer() {
     }
 
     sdl_renderer_ = SDL_CreateRenderer(window_, -1, 0);
-
-    // set the zbuffer entries to be as far back as possible
-    for (int i = 0; i < static_cast<int>(zbuffer_.size()); i++) {
-        for (int j = 0; j < static_cast<int>(zbuffer_[i].size()); j++) {
-            zbuffer_[i][j] = -std::numeric_limits<float>::max();
-        }
-    }
+    texture_ = SDL_CreateTexture(sdl_renderer_, SDL_PIXELFORMAT_ARGB8888,
+                                 SDL_TEXTUREACCESS_STREAMING, output_width_,
+                                 output_height_);
 }
 
 Renderer::~Renderer() {
-    SDL_DestroyWindow(window_);
-    SDL_Quit();
-    delete renderer_;
+    if (window_ != nullptr) {
+        SDL_DestroyTexture(texture_);
+        SDL_DestroyRenderer(sdl_renderer_);
+        SDL_DestroyWindow(window_);
+        SDL_Quit();
+    }
+    if (renderer_ == this)
+        renderer_ = nullptr;
 }
 
 //=============================================================================
 // Utility Functions
 //=============================================================================
 void Renderer::clear_screen() {
-    // make sure render color is black before clearing
-    SDL_SetRenderDrawColor(sdl_renderer_, 0, 0, 0, 0);
+    resize_targets();
+    std::fill(color_.begin(), color_.end(), 0);
+    // set the zbuffer entries to be as far back as possible
+    std::fill(zbuffer_.begin(), zbuffer_.end(),
+              -std::numeric_limits<float>::max());
+}
 
-    SDL_RenderClear(sdl_renderer_);
-    for (int i = 0; i < static_cast<int>(zbuffer_.size()); i++) {
-        for (int j = 0; j < static_cast<int>(zbuffer_[i].size()); j++) {
-            zbuffer_[i][j] = -std::numeric_limits<float>::max();
-        }
+void Renderer::draw_point(int x, int y, const Color& clr) {
+    color_[y * width_ + x] = static_cast<uint32_t>(clr.a) << 24 |
+                             static_cast<uint32_t>(clr.r) << 16 |
+                             static_cast<uint32_t>(clr.g) << 8 |
+                             static_cast<uint32_t>(clr.b);
+}
+
+void Renderer::present() {
+    if (depth_only_)
+        return;
+
+    // at full scale the finished frame is swapped out instead of copied
+    if (width_ == output_width_ && height_ == output_height_)
+        std::swap(color_, framebuffer_);
+    else
+        upscale();
+
+    if (window_ != nullptr) {
+        SDL_UpdateTexture(texture_, nullptr, framebuffer_.data(),
+                          output_width_ * sizeof(uint32_t));
+        SDL_RenderCopy(sdl_renderer_, texture_, nullptr, nullptr);
+        SDL_RenderPresent(sdl_renderer_);
     }
+
+    // the sink swaps in a stale buffer, it is cleared before the next frame
+    if (sink_ != nullptr)
+        sink_->submit(framebuffer_);
 }
 
-void Renderer::draw_point(int x, int y, const Color& clr) {
-    SDL_SetRenderDrawColor(sdl_renderer_, clr.r, clr.g, clr.b, clr.a);
-    SDL_RenderDrawPoint(sdl_renderer_, x, y);
+void Renderer::set_frame_sink(FrameSink* sink) {
+    sink_ = sink;
+}
+
+const PixelBuffer& Renderer::framebuffer() const {
+    return framebuffer_;
+}
+
+const AlignedVector<float>& Renderer::depth_buffer() const {
+    return zbuffer_;
+}
+
+void Renderer::set_output_size(int width, int height) {
+    if (width <= 0 || height <= 0)
+        throw "output size must be positive";
+    output_width_ = width;
+    output_height_ = height;
+    if (!depth_only_)
+        framebuffer_.assign(width * height, 0);
+
+    // the render targets never grow past the output size, so changing the
+    // render scale from frame to frame never allocates
+    if (!depth_only_) {
+        color_.reserve(width * height);
+        upscale_columns_.reserve(width);
+    }
+    zbuffer_.reserve(width * height);
+    width_ = 0;
+    resize_targets();
+
+    // the window follows the output size so the frame is never stretched
+    if (texture_ != nullptr) {
+        SDL_SetWindowSize(window_, width, height);
+        SDL_DestroyTexture(texture_);
+        texture_ = SDL_CreateTexture(sdl_renderer_, SDL_PIXELFORMAT_ARGB8888,
+                                     SDL_TEXTUREACCESS_STREAMING, width,
+                                     height);
+    }
+}
+
+void Renderer::shrink_to_output() {
+    framebuffer_.shrink_to_fit();
+    upscale_columns_.shrink_to_fit();
+    // the render targets keep room for a full scale frame
+    AlignedVector<uint32_t> color{};
+    color.reserve(output_width_ * output_height_);
+    color.assign(color_.begin(), color_.end());
+    color_.swap(color);
+    AlignedVector<float> zbuffer{};
+    zbuffer.reserve(output_width_ * output_height_);
+    zbuffer.assign(zbuffer_.begin(), zbuffer_.end());
+    zbuffer_.swap(zbuffer);
+}
+
+int Renderer::output_width() const {
+    return output_width_;
+}
+
+int Renderer::output_height() const {
+    return output_height_;
+}
+
+void Renderer::set_render_scale(float scale) {
+    render_scale_ = std::clamp(scale, MIN_RENDER_SCALE, 1.f);
+}
+
+float Renderer::render_scale() const {
+    return render_scale_;
+}
+
+int Renderer::width() const {
+    return width_;
+}
+
+int Renderer::height() const {
+    return height_;
+}
+
+RendererMemory Renderer::memory_usage() const {
+    RendererMemory memory{};
+    memory.output = framebuffer_.capacity() * sizeof(uint32_t) +
+                    upscale_columns_.capacity() * sizeof(int);
+    memory.color = color_.capacity() * sizeof(uint32_t);
+    memory.depth = zbuffer_.capacity() * sizeof(float);
+    memory.culling =
+        hiz_.capacity() * sizeof(float) + cluster_state_.capacity();
+    memory.shadows = shadow_map_ ? shadow_map_->memory_usage() : 0;
+    return memory;
+}
+
+std::size_t RendererMemory::total() const {
+    return output + color + depth + culling + shadows;
+}
+
+void Renderer::resize_targets() {
+    int width{std::max(1, static_cast<int>(output_width_ * render_scale_))};
+    int height{std::max(1, static_cast<int>(output_height_ * render_scale_))};
+    if (width == width_ && height == height_)
+        return;
+
+    width_ = width;
+    height_ = height;
+    // start out cleared, the first frame can be drawn without clear_screen()
+    zbuffer_.assign(width_ * height_, -std::numeric_limits<float>::max());
+    if (depth_only_)
+        return;
+    color_.assign(width_ * height_, 0);
+    upscale_columns_.resize(output_width_);
+    for (int x = 0; x < output_width_; x++)
+        upscale_columns_[x] = x * width_ / output_width_;
+}
+
+// nearest neighbour, output rows that come from the same rendered row are
+// copied from the one above
+void Renderer::upscale() {
+    int last_row{-1};
+    for (int y = 0; y < output_height_; y++) {
+        int row{y * height_ / output_height_};
+        uint32_t* out{&framebuffer_[y * output_width_]};
+        if (row == last_row) {
+            std::copy(out - output_width_, out, out);
+            continue;
+        }
+        const uint32_t* in{&color_[row * width_]};
+        for (int x = 0; x < output_width_; x++)
+            out[x] = in[upscale_columns_[x]];
+        last_row = row;
+    }
 }
 
 //=============================================================================
 // Rendering Models
 //=============================================================================
-void Renderer::draw_model(const Model& model) {
+ShaderUniforms Renderer::uniforms(const Color& clr) const {
     Vector<3> z{view_vector(yaw, pitch)};                  // back-forward vec
     Vector<3> x{cross_product({0, 1, 0}, z).normalize()};  // left-right vec
     Vector<3> y{cross_product(z, x).normalize()};          // up-down vec
@@ -93,127 +259,131 @@ void Renderer::draw_model(const Model& model) {
                             {0.f, 0.f, 1 / pos[Z], 1.f}};
 
     // this will scale our points to appropriate sizes for our screen
+    // the model fills the shorter side of the output, and every axis is
+    // scaled by its own render ratio so the upscaled image keeps its aspect
+    float size{std::min(output_width_, output_height_) / 2.f};
+    float scale_x{size * width_ / output_width_};
+    float scale_y{size * height_ / output_height_};
     Matrix<4, 4> viewPort{
-        {SCREEN_WIDTH / 2.f, 0, 0, SCREEN_WIDTH / 2.f},
-        {0, -static_cast<int>(SCREEN_HEIGHT) / 2.f, 0, SCREEN_HEIGHT / 2.f},
+        {scale_x, 0, 0, width_ / 2.f},
+        {0, -scale_y, 0, height_ / 2.f},
         {0, 0, DEPTH / 2.f, DEPTH / 2.f},
         {0, 0, 0, 1.f}};
 
     Matrix<4, 4> transMatrix{viewPort * projMatrix * modelView};
     Matrix<4, 4> normalTransMatrix{inverse(transMatrix).transpose()};
+    return {transMatrix, normalTransMatrix, light_dir, clr};
+}
 
-    for (int i = 0; i < model.nfaces(); i++) {
-        std::vector<FaceTuple> face = model.face(i);
-
-        // transform the point and normal
-        Vector<3> v1 =
-            (transMatrix * model.vertex(face[0].vertex)).dehomogenize();
-        Vector<3> v1n = (normalTransMatrix * model.normal(face[0].normal))
-                            .dehomogenize()
-                            .normalize();
-
-        // triangle fan the face polygon (most of the time this is just a
-        // triangle. outer loop for start points
-        for (int j = 2; j < static_cast<int>(face.size()); j++) {
-            // get the position and normal of the second point and transform
-            // them
-            Vector<3> v2 =
-                (transMatrix * model.vertex(face[j - 1].vertex)).dehomogenize();
-            Vector<3> v2n =
-                (normalTransMatrix * model.normal(face[j - 1].normal))
-                    .dehomogenize()
-                    .normalize();
-
-            // get the position and normal of the third point and transform them
-            Vector<3> v3 =
-                (transMatrix * model.vertex(face[j].vertex)).dehomogenize();
-            Vector<3> v3n = (normalTransMatrix * model.normal(face[j].normal))
-                                .dehomogenize()
-                                .normalize();
-
-            Triangle triangle{{{v1, v1n}, {v2, v2n}, {v3, v3n}}};
-            draw_face(triangle, {255, 255, 255, 255});
-        }
+void Renderer::draw_model(const Model& model) {
+    draw_model(model, FlatShader{});
+}
+
+// pick the shader once for the whole model, every mode has its own
+// instantiation of the pipeline
+void Renderer::draw_model(const Model& model, ShadingMode mode) {
+    switch (mode) {
+        case ShadingMode::flat:
+            draw_model(model, FlatShader{});
+            break;
+        case ShadingMode::gouraud:
+            draw_model(model, GouraudShader{});
+            break;
+        case ShadingMode::phong:
+            draw_model(model, PhongShader{});
+            break;
+        case ShadingMode::depth:
+            draw_model(model, DepthShader{});
+            break;
+        case ShadingMode::normals:
+            draw_model(model, NormalShader{});
+            break;
+        case ShadingMode::shadows:
+            draw_shadowed(model);
+            break;
     }
-    SDL_RenderPresent(sdl_renderer_);
+}
+
+// the shadow map is only redrawn when the light or the model changed
+void Renderer::draw_shadowed(const Model& model) {
+    if (!shadow_map_)
+        shadow_map_ = std::make_unique<ShadowMap>();
+    shadow_map_->update(model, shadow_light);
+    draw_model(model, ShadowShader{shadow_map_.get(),
+                                   (-1.f * shadow_light).normalize()});
 }
 
 void Renderer::draw_face(const Triangle& triangle, const Color& clr) {
-    Vector<3> v1 = triangle[0].pos;
-    Vector<3> v2 = triangle[1].pos;
-    Vector<3> v3 = triangle[2].pos;
-
-    // create a bounding box around the triangle to be drawn
-    int maxX = std::min({static_cast<int>(std::max({v1[X], v2[X], v3[X]})), SCREEN_WIDTH - 1});
- 	int minX = std::max({static_cast<int>(std::min({v1[X], v2[X], v3[X]})), 0});
-    int maxY = std::min({static_cast<int>(std::max({v1[Y], v2[Y], v3[Y]})), SCREEN_HEIGHT - 1});
-    int minY = std::max({static_cast<int>(std::min({v1[Y], v2[Y], v3[Y]})), 0});
-
-    // parametrize the plane created by the triangular face.
-    //
-    // Planes can be parametrized using the general equation:
-    // ax + by + cz = d
-    // where (a, b, c) is the norm of the plane. A norm can be trivially found 
-	// by taking the cross product of two vectors on the plane.
-	//
-	// afterwards d can be solved for by substituting x, y, and z with a point
-	// found on the plane. Now z can be created as a function of x, and y
-	//
-	// z = 1/c * (-ax -by + d)
-	//
-	// therefore we have: z(x, y) = 1/c * (-ax -by + d)
-	//
-	// there is a convenient property that
-	// z(x + 1, y) = 1/c * (-a(x+1) - by + d)
-	// 			   = 1/c * (-ax -a -by + d)
-	// 			   = 1/c * (-ax -by + d) - a/c
-	// 			   = z(x, y) - a/c
-	//
-	// using a similar technique we have
-	// z(x, y + 1) = z(x, y) -b/c
-
-    Vector<3> v2_delta = v2 - v1;
-    Vector<3> v3_delta = v3 - v1;
-
-    Vector<3> plane_norm = cross_product(v2_delta, v3_delta);
-
-	// the plane is parallel with the z axis (don't render it)
-	if(plane_norm[Z] == 0) {
-		return;
-	}
-
-	float d = v1[X]*plane_norm[X] + v1[Y]*plane_norm[Y] + v1[Z]*plane_norm[Z];
-
-	float delta_x = -plane_norm[X]/plane_norm[Z];
-	float delta_y = -plane_norm[Y]/plane_norm[Z];
-
-	// what is the z value at (minX, minY)?
-	float z_row = (d - plane_norm[X] * minX - plane_norm[Y] * minY) / plane_norm[Z];
-
-	Vector<3> norm = 1/3.f * (triangle[0].norm + triangle[1].norm + triangle[2].norm);
-    for (int x = minX; x <= maxX; x++) {
-		float z = z_row;
-        for (int y = minY; y <= maxY; y++) {
-            if (not InsideTriangle(triangle, static_cast<float>(x),
-                                   static_cast<float>(y))) {
-                continue;
-            }
-            if (z >= zbuffer_[x][y]) {
-                zbuffer_[x][y] = z;
-//                Vector<3> norm{findNormalSolution(
-//                    triangle, static_cast<float>(x), static_cast<float>(y))};
-                float intensity{dot_product(light_dir, norm.normalize())};
-                if (intensity > 0) {
-                    draw_point(x, y,
-                               {static_cast<int>(clr.r * intensity),
-                                static_cast<int>(clr.g * intensity),
-                                static_cast<int>(clr.b * intensity), 255});
-                }
-            }
-			z += delta_y;	
+    // the triangle is already in screen space so only the light is needed
+    draw_face(FlatShader{}, {{}, {}, light_dir, clr},
+              {{{triangle[0].pos, triangle[0].norm},
+                {triangle[1].pos, triangle[1].norm},
+                {triangle[2].pos, triangle[2].norm}}});
+}
+
+//=============================================================================
+// Occlusion Culling
+//=============================================================================
+void Renderer::build_hiz() {
+    int tiles_x{(width_ + HIZ_TILE - 1) / HIZ_TILE};
+    int tiles_y{(height_ + HIZ_TILE - 1) / HIZ_TILE};
+    hiz_.assign(tiles_x * tiles_y, std::numeric_limits<float>::max());
+
+    for (int y = 0; y < height_; y++) {
+        float* tiles{&hiz_[(y / HIZ_TILE) * tiles_x]};
+        const float* row{&zbuffer_[y * width_]};
+        for (int tx = 0; tx < tiles_x; tx++) {
+            float farthest{tiles[tx]};
+            int last{std::min((tx + 1) * HIZ_TILE, width_)};
+            for (int x = tx * HIZ_TILE; x < last; x++)
+                farthest = std::min(farthest, row[x]);
+            tiles[tx] = farthest;
+        }
+    }
+}
+
+// a cluster is occluded when the nearest point of its bounding box is behind
+// the farthest depth of every tile its screen rectangle touches
+bool Renderer::occluded(const Cluster& cluster,
+                        const ShaderUniforms& u) const {
+    int tiles_x{(width_ + HIZ_TILE - 1) / HIZ_TILE};
+
+    float min_x{std::numeric_limits<float>::max()};
+    float min_y{std::numeric_limits<float>::max()};
+    float max_x{-std::numeric_limits<float>::max()};
+    float max_y{-std::numeric_limits<float>::max()};
+    float max_z{-std::numeric_limits<float>::max()};
+    for (int corner = 0; corner < 8; corner++) {
+        Vector<4> p{corner & 1 ? cluster.hi[X] : cluster.lo[X],
+                    corner & 2 ? cluster.hi[Y] : cluster.lo[Y],
+                    corner & 4 ? cluster.hi[Z] : cluster.lo[Z], 1.f};
+        Vector<4> projected{u.transform * p};
+        if (projected[W] <= 0)  // crosses the camera plane, can't tell
+            return false;
+
+        Vector<3> screen{projected.dehomogenize()};
+        min_x = std::min(min_x, screen[X]);
+        min_y = std::min(min_y, screen[Y]);
+        max_x = std::max(max_x, screen[X]);
+        max_y = std::max(max_y, screen[Y]);
+        max_z = std::max(max_z, screen[Z]);
+    }
+
+    // completely off screen clusters can't be seen either
+    int first_x{std::max(static_cast<int>(min_x), 0)};
+    int first_y{std::max(static_cast<int>(min_y), 0)};
+    int last_x{std::min(static_cast<int>(max_x), width_ - 1)};
+    int last_y{std::min(static_cast<int>(max_y), height_ - 1)};
+    if (first_x > last_x || first_y > last_y)
+        return true;
+
+    for (int ty = first_y / HIZ_TILE; ty <= last_y / HIZ_TILE; ty++) {
+        for (int tx = first_x / HIZ_TILE; tx <= last_x / HIZ_TILE; tx++) {
+            if (max_z >= hiz_[ty * tiles_x + tx])
+                return false;
         }
-		z_row += delta_x;
     }
+    return true;
 }
 
 // given a triangle in a 2D space determine if a point (x, y) is contained
@@ -0,0 +1,222 @@
+#include "replay.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <numbers>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "memory_stats.h"
+#include "model.h"
+#include "renderer.h"
+#include "resolution_controller.h"
+#include "shader.h"
+
+std::vector<Scene> Replay::parse_scenes(const std::string& filename) {
+    std::ifstream inf{filename};
+    if (!inf)
+        throw std::runtime_error("could not open scene script " + filename);
+
+    std::vector<Scene> scenes{};
+    int line_number{0};
+    for (std::string line{}; std::getline(inf, line);) {
+        line_number++;
+        line = line.substr(0, line.find('#'));
+
+        std::istringstream words{line};
+        std::string key{};
+        if (!(words >> key))
+            continue;
+
+        auto error = [&](const std::string& message) {
+            return std::runtime_error(filename + ":" +
+                                      std::to_string(line_number) + ": " +
+                                      message);
+        };
+
+        if (key == "scene") {
+            scenes.emplace_back();
+            words >> scenes.back().name;
+            continue;
+        }
+        if (scenes.empty())
+            throw error("settings must come after a scene line");
+
+        Scene& scene{scenes.back()};
+        if (key == "model") {
+            // model paths are relative to the script
+            words >> scene.model;
+            scene.model = (std::filesystem::path{filename}.parent_path() /
+                           scene.model)
+                              .string();
+        } else if (key == "optimize") {
+            scene.options.optimize = true;
+        } else if (key == "compact") {
+            // optionally followed by the bits per normal component
+            scene.options.compact = true;
+            int bits{};
+            if (words >> bits)
+                scene.options.normal_bits = bits;
+            words.clear();
+        } else if (key == "crease") {
+            float degrees{};
+            words >> degrees;
+            scene.options.crease_angle =
+                degrees * std::numbers::pi_v<float> / 180.f;
+        } else if (key == "resolution") {
+            words >> scene.width >> scene.height;
+        } else if (key == "target") {
+            words >> scene.target_ms;
+        } else if (key == "shading") {
+            words >> scene.shading;
+        } else if (key == "occlusion") {
+            scene.occlusion_culling = true;
+        } else if (key == "frames") {
+            words >> scene.frames;
+        } else if (key == "allocations") {
+            words >> scene.max_allocations;
+        } else if (key == "yaw") {
+            words >> scene.yaw_start >> scene.yaw_end;
+        } else if (key == "pitch") {
+            words >> scene.pitch_start >> scene.pitch_end;
+        } else {
+            throw error("unknown setting " + key);
+        }
+
+        if (words.fail())
+            throw error("missing or malformed value for " + key);
+    }
+
+    for (const Scene& scene : scenes) {
+        if (scene.model.empty())
+            throw std::runtime_error("scene " + scene.name + " has no model");
+        if (scene.frames <= 0)
+            throw std::runtime_error("scene " + scene.name + " has no frames");
+    }
+    return scenes;
+}
+
+SceneRun Replay::run_scene(const Scene& scene) {
+    if (scene.width <= 0 || scene.height <= 0)
+        throw std::runtime_error("scene " + scene.name +
+                                 ": invalid resolution");
+    std::optional<ShadingMode> mode{parse_shading_mode(scene.shading)};
+    if (!mode)
+        throw std::runtime_error("scene " + scene.name +
+                                 ": unknown shading mode " + scene.shading);
+
+    SceneRun run{};
+    AllocationScope load{};
+    Model model{scene.model, scene.options};
+    run.load = load.stats();
+
+    // every scene gets its own renderer, so neither the buffers nor the
+    // culling and shadow state of an earlier scene carry over
+    std::unique_ptr<Renderer> renderer{Renderer::CreateHeadlessRenderer()};
+    renderer->occlusion_culling = scene.occlusion_culling;
+    renderer->set_output_size(scene.width, scene.height);
+    renderer->shrink_to_output();
+    renderer->set_render_scale(1.f);
+
+    std::optional<ResolutionController> resolution{};
+    if (scene.target_ms > 0)
+        resolution.emplace(scene.target_ms);
+
+    run.frame_times.reserve(scene.frames);
+    run.frame_allocations.reserve(scene.frames);
+
+    float radians{std::numbers::pi_v<float> / 180.f};
+    for (int i = 0; i < scene.frames; i++) {
+        float t{static_cast<float>(i) / static_cast<float>(scene.frames)};
+        renderer->yaw =
+            radians * (scene.yaw_start + t * (scene.yaw_end - scene.yaw_start));
+        renderer->pitch =
+            radians *
+            (scene.pitch_start + t * (scene.pitch_end - scene.pitch_start));
+
+        AllocationScope frame{};
+        auto start = std::chrono::steady_clock::now();
+        renderer->clear_screen();
+        renderer->draw_model(model, *mode);
+        auto stop = std::chrono::steady_clock::now();
+        run.frame_allocations.push_back(frame.stats().count);
+
+        run.frame_times.push_back(
+            std::chrono::duration<float, std::milli>(stop - start).count());
+        if (resolution) {
+            renderer->set_render_scale(
+                resolution->update(run.frame_times.back()));
+        }
+    }
+
+    run.model = model.memory_usage();
+    run.renderer = renderer->memory_usage();
+    return run;
+}
+
+float Replay::percentile(const std::vector<float>& sorted, float p) {
+    if (sorted.empty())
+        return 0.f;
+    int size{static_cast<int>(sorted.size())};
+    int rank{static_cast<int>(std::ceil(p / 100.f * size))};
+    return sorted[std::clamp(rank - 1, 0, size - 1)];
+}
+
+FrameStats Replay::summarize(const std::string& scene, const SceneRun& run) {
+    std::vector<float> frame_times{run.frame_times};
+    std::sort(frame_times.begin(), frame_times.end());
+
+    float total{};
+    for (float time : frame_times)
+        total += time;
+
+    FrameStats stats{};
+    stats.scene = scene;
+    stats.frames = static_cast<int>(frame_times.size());
+    stats.p50 = percentile(frame_times, 50.f);
+    stats.p95 = percentile(frame_times, 95.f);
+    stats.p99 = percentile(frame_times, 99.f);
+    stats.max = frame_times.empty() ? 0.f : frame_times.back();
+    stats.fps = total > 0 ? 1000.f * stats.frames / total : 0.f;
+    for (int i = 1; i < static_cast<int>(run.frame_allocations.size()); i++) {
+        stats.allocations =
+            std::max(stats.allocations, run.frame_allocations[i]);
+    }
+    return stats;
+}
+
+std::vector<FrameStats> Replay::load_baseline(const std::string& filename) {
+    std::ifstream inf{filename};
+    if (!inf)
+        throw std::runtime_error("could not open baseline " + filename);
+
+    std::vector<FrameStats> baseline{};
+    for (std::string line{}; std::getline(inf, line);) {
+        std::istringstream words{line.substr(0, line.find('#'))};
+        FrameStats stats{};
+        if (words >> stats.scene >> stats.p50 >> stats.p95 >> stats.p99 >>
+            stats.max >> stats.fps)
+            baseline.push_back(stats);
+    }
+    return baseline;
+}
+
+void Replay::save_baseline(const std::string& filename,
+                           const std::vector<FrameStats>& stats) {
+    std::ofstream outf{filename};
+    if (!outf)
+        throw std::runtime_error("could not write baseline " + filename);
+
+    outf << "# scene p50 p95 p99 max (ms) fps\n";
+    for (const FrameStats& s : stats) {
+        outf << s.scene << " " << s.p50 << " " << s.p95 << " " << s.p99 << " "
+             << s.max << " " << s.fps << "\n";
+    }
+}
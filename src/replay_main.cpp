@@ -0,0 +1,149 @@
+#include <cstddef>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "replay.h"
+
+// Replays scripted scenes headlessly and reports frame time percentiles and
+// the most heap allocations made by a frame.
+//
+// usage: replay <script> [--baseline <file>] [--threshold <percent>]
+//                        [--max-threshold <percent>]
+//                        [--save-baseline <file>] [--memory]
+//
+// With a baseline the program exits with 1 if the p50, p95 or p99 frame time
+// of any scene got slower than the baseline by more than the threshold, or
+// the worst frame by more than the max threshold (default 50, single frames
+// are noisier than percentiles). It also exits with 1 if a scene makes more
+// allocations per frame than its script allows. --memory reports the memory
+// used by the model and the render targets of every scene, each scene is
+// drawn by a renderer of its own.
+
+// bytes in KiB for the memory report
+static float kib(std::size_t bytes) {
+    return static_cast<float>(bytes) / 1024.f;
+}
+
+static void print_memory(const SceneRun& run) {
+    std::cout << "  model KiB: positions " << kib(run.model.positions)
+              << ", normals " << kib(run.model.normals) << ", faces "
+              << kib(run.model.faces) << ", clusters "
+              << kib(run.model.clusters) << ", total "
+              << kib(run.model.total()) << "\n";
+    std::cout << "  loading: " << run.load.count << " allocations, "
+              << kib(run.load.bytes) << " KiB\n";
+    std::cout << "  render targets KiB: output " << kib(run.renderer.output)
+              << ", color " << kib(run.renderer.color) << ", depth "
+              << kib(run.renderer.depth) << ", culling "
+              << kib(run.renderer.culling) << ", shadows "
+              << kib(run.renderer.shadows) << ", total "
+              << kib(run.renderer.total()) << "\n";
+}
+
+int main(int argc, char** argv) {
+    std::optional<std::string> script{};
+    std::optional<std::string> baseline_file{};
+    std::optional<std::string> save_file{};
+    float threshold{10.f};
+    float max_threshold{50.f};
+    bool memory{false};
+
+    for (int i = 1; i < argc; i++) {
+        std::string_view arg{argv[i]};
+        if (arg == "--baseline" && i + 1 < argc)
+            baseline_file = argv[++i];
+        else if (arg == "--save-baseline" && i + 1 < argc)
+            save_file = argv[++i];
+        else if (arg == "--threshold" && i + 1 < argc)
+            threshold = std::stof(argv[++i]);
+        else if (arg == "--max-threshold" && i + 1 < argc)
+            max_threshold = std::stof(argv[++i]);
+        else if (arg == "--memory")
+            memory = true;
+        else
+            script = argv[i];
+    }
+
+    if (!script) {
+        std::cerr << "usage: " << argv[0]
+                  << " <script> [--baseline <file>] [--threshold <percent>]"
+                     " [--max-threshold <percent>]"
+                     " [--save-baseline <file>] [--memory]\n";
+        return 2;
+    }
+
+    try {
+        std::vector<FrameStats> results{};
+        std::cout << std::left << std::setw(20) << "scene" << std::right
+                  << std::setw(8) << "frames" << std::setw(10) << "p50 ms"
+                  << std::setw(10) << "p95 ms" << std::setw(10) << "p99 ms"
+                  << std::setw(10) << "max ms" << std::setw(10) << "fps"
+                  << std::setw(8) << "allocs" << "\n";
+        std::cout << std::fixed << std::setprecision(2);
+
+        bool failed{false};
+        for (const Scene& scene : Replay::parse_scenes(*script)) {
+            SceneRun run{Replay::run_scene(scene)};
+            FrameStats stats{Replay::summarize(scene.name, run)};
+            std::cout << std::left << std::setw(20) << stats.scene
+                      << std::right << std::setw(8) << stats.frames
+                      << std::setw(10) << stats.p50 << std::setw(10)
+                      << stats.p95 << std::setw(10) << stats.p99
+                      << std::setw(10) << stats.max << std::setw(10)
+                      << stats.fps << std::setw(8) << stats.allocations
+                      << "\n";
+            if (memory)
+                print_memory(run);
+            results.push_back(stats);
+
+            uint64_t allowed{static_cast<uint64_t>(scene.max_allocations)};
+            if (scene.max_allocations >= 0 && stats.allocations > allowed) {
+                failed = true;
+                std::cout << "ALLOCATIONS " << stats.scene << ": "
+                          << stats.allocations << " in a frame > "
+                          << scene.max_allocations << "\n";
+            }
+        }
+
+        if (save_file)
+            Replay::save_baseline(*save_file, results);
+
+        if (!baseline_file)
+            return failed ? 1 : 0;
+
+        bool regressed{failed};
+        for (const FrameStats& base : Replay::load_baseline(*baseline_file)) {
+            for (const FrameStats& stats : results) {
+                if (stats.scene != base.scene)
+                    continue;
+
+                auto check = [&](const char* name, float now, float before,
+                                 float allowed) {
+                    if (now <= before * (1.f + allowed / 100.f))
+                        return;
+                    regressed = true;
+                    std::cout << "REGRESSION " << stats.scene << " " << name
+                              << ": " << before << " ms -> " << now << " ms ("
+                              << (now / before - 1.f) * 100.f << "% > "
+                              << allowed << "%)\n";
+                };
+                check("p50", stats.p50, base.p50, threshold);
+                check("p95", stats.p95, base.p95, threshold);
+                check("p99", stats.p99, base.p99, threshold);
+                check("max", stats.max, base.max, max_threshold);
+            }
+        }
+        return regressed ? 1 : 0;
+
+    } catch (const std::exception& ex) {
+        std::cerr << ex.what() << "\n";
+    } catch (const char* ex) {
+        std::cerr << ex << "\n";
+    }
+    return 2;
+}
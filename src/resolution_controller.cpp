@@ -0,0 +1,46 @@
+#include "resolution_controller.h"
+
+#include <algorithm>
+#include <cmath>
+
+// how much of a new frame time goes into the average, and how far the scale
+// moves towards the ideal one every frame
+constexpr float AVERAGE_WEIGHT = 0.1f;
+constexpr float DAMPING = 0.25f;
+
+// frame times this close to the target leave the scale alone so it does
+// not flicker between two sizes
+constexpr float DEAD_BAND = 0.05f;
+
+ResolutionController::ResolutionController(float target_ms,
+                                           float min_scale,
+                                           float max_scale)
+    : target_ms_{target_ms},
+      min_scale_{min_scale},
+      max_scale_{max_scale},
+      scale_{max_scale} {
+    if (target_ms <= 0)
+        throw "target frame time must be positive";
+    if (min_scale <= 0 || min_scale > max_scale)
+        throw "invalid render scale range";
+}
+
+float ResolutionController::update(float frame_ms) {
+    if (average_ms_ == 0)
+        average_ms_ = frame_ms;
+    else
+        average_ms_ += AVERAGE_WEIGHT * (frame_ms - average_ms_);
+
+    float error{average_ms_ / target_ms_};
+    if (average_ms_ <= 0 || std::abs(error - 1) < DEAD_BAND)
+        return scale_;
+
+    float ideal{scale_ / std::sqrt(error)};
+    scale_ = std::clamp(scale_ + DAMPING * (ideal - scale_), min_scale_,
+                        max_scale_);
+    return scale_;
+}
+
+float ResolutionController::scale() const {
+    return scale_;
+}
@@ -0,0 +1,175 @@
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include "model.h"
+#include "model_cache.h"
+#include "render_server.h"
+
+// Long running render server. Requests (see include/render_server.h) are
+// read one per line from stdin, or from every client connecting to a Unix
+// domain socket, and the replies are written back the same way.
+//
+// usage: render_server [--socket <path>] [--workers <n>] [--cache-mb <n>]
+//                      [--optimize] [--compact]
+//
+// Reading from stdin the server exits once stdin is closed and every
+// request has been answered.
+
+// a client connected to the socket. Replies can still be in flight after
+// the client stops sending, so the connection is closed once the last one
+// is written.
+class Connection {
+   public:
+    explicit Connection(int fd) : fd_{fd} {}
+    ~Connection() { close(fd_); }
+
+    Connection(const Connection&) = delete;
+    void operator=(const Connection&) = delete;
+
+    int fd() const { return fd_; }
+
+    void send(const std::string& line) {
+        std::lock_guard lock{mutex_};
+        std::string message{line + "\n"};
+        for (std::size_t sent = 0; sent < message.size();) {
+            ssize_t n{::send(fd_, message.data() + sent, message.size() - sent,
+                             MSG_NOSIGNAL)};
+            if (n <= 0)
+                return;  // the client went away
+            sent += n;
+        }
+    }
+
+   private:
+    int fd_;
+    std::mutex mutex_{};
+};
+
+static void serve_client(RenderServer& server,
+                         std::shared_ptr<Connection> connection) {
+    std::string buffer{};
+    char chunk[4096];
+    for (;;) {
+        ssize_t n{recv(connection->fd(), chunk, sizeof(chunk), 0)};
+        if (n <= 0)
+            return;
+        buffer.append(chunk, n);
+
+        for (std::size_t end; (end = buffer.find('\n')) != std::string::npos;) {
+            std::string line{buffer.substr(0, end)};
+            buffer.erase(0, end + 1);
+            if (line.find_first_not_of(" \t\r") == std::string::npos)
+                continue;
+            server.submit(line, [connection](const std::string& reply) {
+                connection->send(reply);
+            });
+        }
+    }
+}
+
+static void serve_socket(RenderServer& server, const std::string& path) {
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path))
+        throw std::runtime_error("socket path too long: " + path);
+    std::strcpy(address.sun_path, path.c_str());
+
+    int listener{socket(AF_UNIX, SOCK_STREAM, 0)};
+    if (listener < 0)
+        throw std::runtime_error("could not create socket");
+    unlink(path.c_str());  // left over from an earlier run
+    if (bind(listener, reinterpret_cast<sockaddr*>(&address),
+             sizeof(address)) < 0 ||
+        listen(listener, SOMAXCONN) < 0) {
+        close(listener);
+        throw std::runtime_error("could not listen on " + path);
+    }
+
+    std::cerr << "listening on " << path << "\n";
+    for (;;) {
+        int fd{accept(listener, nullptr, nullptr)};
+        if (fd < 0)
+            continue;
+        std::thread{serve_client, std::ref(server),
+                    std::make_shared<Connection>(fd)}
+            .detach();
+    }
+}
+
+// the replies can still be written after this returns, while the server
+// drains its queue, so the mutex guarding stdout belongs to the caller
+static void serve_stdin(RenderServer& server, std::mutex& output) {
+    for (std::string line{}; std::getline(std::cin, line);) {
+        if (line.find_first_not_of(" \t\r") == std::string::npos)
+            continue;
+        server.submit(line, [&output](const std::string& reply) {
+            std::lock_guard lock{output};
+            std::cout << reply << std::endl;
+        });
+    }
+}
+
+static int usage(const char* program) {
+    std::cerr << "usage: " << program
+              << " [--socket <path>] [--workers <n>] [--cache-mb <n>]"
+                 " [--optimize] [--compact]\n";
+    return 2;
+}
+
+int main(int argc, char** argv) {
+    std::optional<std::string> socket_path{};
+    int workers{
+        std::max(static_cast<int>(std::thread::hardware_concurrency()), 1)};
+    std::size_t cache_mb{512};
+    ModelOptions options{};
+
+    // stoi and stoul throw on anything that isn't a number
+    try {
+        for (int i = 1; i < argc; i++) {
+            std::string_view arg{argv[i]};
+            if (arg == "--socket" && i + 1 < argc)
+                socket_path = argv[++i];
+            else if (arg == "--workers" && i + 1 < argc)
+                workers = std::max(std::stoi(argv[++i]), 1);
+            else if (arg == "--cache-mb" && i + 1 < argc)
+                cache_mb = std::stoul(argv[++i]);
+            else if (arg == "--optimize")
+                options.optimize = true;
+            else if (arg == "--compact")
+                options.compact = true;
+            else
+                return usage(argv[0]);
+        }
+    } catch (const std::logic_error&) {
+        return usage(argv[0]);
+    }
+
+    try {
+        // as many loader threads as workers, so every worker waiting on a
+        // different model gets it loaded at once
+        ModelCache cache{cache_mb << 20, options, workers};
+        std::mutex output{};
+        RenderServer server{cache, workers};
+        if (socket_path)
+            serve_socket(server, *socket_path);
+        else
+            serve_stdin(server, output);
+    } catch (const std::exception& ex) {
+        std::cerr << ex.what() << "\n";
+        return 2;
+    }
+    return 0;
+}
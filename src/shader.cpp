@@ -0,0 +1,20 @@
+#include "shader.h"
+
+#include <optional>
+#include <string_view>
+
+std::optional<ShadingMode> parse_shading_mode(std::string_view name) {
+    if (name == "flat")
+        return ShadingMode::flat;
+    if (name == "gouraud")
+        return ShadingMode::gouraud;
+    if (name == "phong")
+        return ShadingMode::phong;
+    if (name == "depth")
+        return ShadingMode::depth;
+    if (name == "normals")
+        return ShadingMode::normals;
+    if (name == "shadows")
+        return ShadingMode::shadows;
+    return std::nullopt;
+}
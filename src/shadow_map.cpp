@@ -0,0 +1,92 @@
+#include "shadow_map.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <memory>
+#include <vector>
+#include "model.h"
+#include "renderer.h"
+#include "shader.h"
+#include "vector.h"
+
+// depth bias in texels, a tilted surface changes its depth by about a texel
+// from one texel to the next
+constexpr float SHADOW_BIAS = 1.5f;
+
+ShadowMap::ShadowMap(int size)
+    : size_{size}, renderer_{Renderer::CreateDepthRenderer()} {
+    renderer_->set_output_size(size, size);
+}
+
+bool ShadowMap::update(const Model& model, const Vector<3>& light_dir) {
+    if (model.revision() == revision_ && light_dir[X] == light_dir_[X] &&
+        light_dir[Y] == light_dir_[Y] && light_dir[Z] == light_dir_[Z])
+        return false;
+    revision_ = model.revision();
+    light_dir_ = light_dir;
+
+    // basis of the light, z points towards the light so that closer to the
+    // light is larger like in the zbuffer
+    Vector<3> z{(-1.f * light_dir).normalize()};
+    Vector<3> up{std::abs(z[Y]) < 0.99f ? Vector<3>{0, 1, 0}
+                                        : Vector<3>{1, 0, 0}};
+    Vector<3> x{cross_product(up, z).normalize()};
+    Vector<3> y{cross_product(z, x)};
+
+    // fit the bounding box of the model into the map, keeping a texel free
+    // on every side
+    float lo_x{std::numeric_limits<float>::max()}, hi_x{-lo_x};
+    float lo_y{std::numeric_limits<float>::max()}, hi_y{-lo_y};
+    for (const Cluster& cluster : model.clusters()) {
+        for (int corner = 0; corner < 8; corner++) {
+            Vector<3> p{corner & 1 ? cluster.hi[X] : cluster.lo[X],
+                        corner & 2 ? cluster.hi[Y] : cluster.lo[Y],
+                        corner & 4 ? cluster.hi[Z] : cluster.lo[Z]};
+            lo_x = std::min(lo_x, dot_product(p, x));
+            hi_x = std::max(hi_x, dot_product(p, x));
+            lo_y = std::min(lo_y, dot_product(p, y));
+            hi_y = std::max(hi_y, dot_product(p, y));
+        }
+    }
+    float extent{std::max({hi_x - lo_x, hi_y - lo_y, 1e-6f})};
+    float scale{(size_ - 3) / extent};
+
+    transform_ = {{scale * x[X], scale * x[Y], scale * x[Z], 1 - scale * lo_x},
+                  {scale * y[X], scale * y[Y], scale * y[Z], 1 - scale * lo_y},
+                  {z[X], z[Y], z[Z], 0.f},
+                  {0.f, 0.f, 0.f, 1.f}};
+    bias_ = SHADOW_BIAS / scale;
+
+    // without the flip of the camera's viewport the faces turned towards the
+    // light are wound clockwise and culled, leaving only the back faces
+    renderer_->clear_screen();
+    renderer_->draw_model(model, DepthShader{}, {transform_, {}, {}, {}});
+    return true;
+}
+
+const Matrix<4, 4>& ShadowMap::transform() const {
+    return transform_;
+}
+
+float ShadowMap::visibility(const Vector<3>& p) const {
+    const AlignedVector<float>& depth{renderer_->depth_buffer()};
+    int cx{static_cast<int>(std::lround(p[X]))};
+    int cy{static_cast<int>(std::lround(p[Y]))};
+
+    int lit{0};
+    for (int y = cy - 1; y <= cy + 1; y++) {
+        for (int x = cx - 1; x <= cx + 1; x++) {
+            // outside of the map nothing casts a shadow
+            if (x < 0 || y < 0 || x >= size_ || y >= size_ ||
+                p[Z] + bias_ >= depth[y * size_ + x])
+                lit++;
+        }
+    }
+    return lit / 9.f;
+}
+
+std::size_t ShadowMap::memory_usage() const {
+    return renderer_->memory_usage().total();
+}